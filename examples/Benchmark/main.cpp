@@ -0,0 +1,255 @@
+#include <Arduino.h>
+#include <XPLDevices.h>
+
+// This sample measures the time per handle() call of all device classes on a scaled panel,
+// to size the loop budget of a real device. XP talks to a scripted stream instead of the plugin,
+// read the results with the serial monitor. Each run prints one CSV block:
+//   bench,<name>,<calls>,<ns per call>,<cycles per call>
+// Cycles are derived from F_CPU. Results depend on the board and the defines in platformio.ini.
+// host/bench/bench_devices.cpp measures the same device classes on the host build, e.g. in CI.
+
+#define BENCH_ROUNDS 20 // rounds over all devices of a class per measurement
+
+#define NUM_BUTTONS 200
+#define NUM_ENCODERS 30
+#define NUM_SWITCHES 20
+#define NUM_MUX 6
+
+// devices are spread over the 6 mux, pins overlap which does not matter for timing
+Button *buttons[NUM_BUTTONS];
+RepeatButton *repeatButtons[NUM_SWITCHES];
+Switch *switches[NUM_SWITCHES];
+Switch2 *switches2[NUM_SWITCHES];
+Encoder *encoders[NUM_ENCODERS];
+#define BUTTON_PERIOD 48 // lcm of NUM_MUX and 16, buttons n and n + 48 share an input
+int8_t firstButton[NUM_MUX][16]; // first button on each input, -1 for none
+uint8_t activeButtons[NUM_BUTTONS]; // edge driven panel: buttons with a pending event or debounce
+bool buttonActive[NUM_BUTTONS];
+int numActive;
+AnalogIn analog(A0, unipolar, 10);
+ShiftOut shiftOut(8, 9, 10, 32);
+LedShift ledShift(11, 12, 13, 32);
+
+#define NUM_DATAREFS 4 // written datarefs, with the commands of 4 buttons within the limits of small boards
+long values[NUM_DATAREFS];
+
+// Stream in place of the plugin: answers the handshake and the registrations like the plugin does,
+// then stays silent. XP runs connected on it, so xloop() is measured with its datarefs scheduled.
+class ScriptStream : public Stream
+{
+public:
+  ScriptStream() { _reply("<a>"); }
+  int available() { return _inLength - _inPos; }
+  int read() { return _inPos < _inLength ? _in[_inPos++] : -1; }
+  int peek() { return _inPos < _inLength ? _in[_inPos] : -1; }
+  int availableForWrite() { return 64; }
+  size_t write(uint8_t c)
+  {
+    if (c == XPLDIRECT_PACKETHEADER)
+    {
+      _frameLength = 0;
+    }
+    if (_frameLength < sizeof(_frame) - 1)
+    {
+      _frame[_frameLength++] = c;
+    }
+    if (c == XPLDIRECT_PACKETTRAILER && _frameLength > 2)
+    {
+      _frame[_frameLength - 1] = 0; // name without trailer
+      _answer();
+    }
+    return 1;
+  }
+
+private:
+  char _in[100];
+  byte _inLength = 0;
+  byte _inPos = 0;
+  char _frame[XPLMAX_PACKETSIZE];
+  byte _frameLength = 0;
+  int _handle = 0;
+
+  void _reply(const char *frame)
+  {
+    if (_inPos == _inLength)
+    {
+      _inPos = _inLength = 0;
+    }
+    while (*frame && _inLength < sizeof(_in))
+    {
+      _in[_inLength++] = *frame++;
+    }
+  }
+
+  // frames of the device: header, command, payload
+  void _answer()
+  {
+    char reply[XPLMAX_PACKETSIZE + 8];
+    switch (_frame[1])
+    {
+    case XPLRESPONSE_NAME:
+      break;
+    case XPLREQUEST_REGISTERDATAREF: // rw, index, divider, name
+      snprintf(reply, sizeof(reply), "<%c%03d%s>", XPLRESPONSE_DATAREF, _handle++, &_frame[13]);
+      _reply(reply);
+      break;
+    case XPLREQUEST_REGISTERCOMMAND:
+      snprintf(reply, sizeof(reply), "<%c%03d%s>", XPLRESPONSE_COMMAND, _handle++, &_frame[2]);
+      _reply(reply);
+      break;
+    default: // updates, commands and XPLREQUEST_NOREQUESTS, registration is done
+      return;
+    }
+    _reply("<f>"); // poll for the next request
+  }
+};
+ScriptStream scriptStream;
+
+// run statement for all calls of a class and print the result
+#define BENCH(name, count, statement)                      \
+  {                                                        \
+    unsigned long start = micros();                        \
+    for (int round = 0; round < BENCH_ROUNDS; round++)     \
+    {                                                      \
+      for (int n = 0; n < (count); n++)                    \
+      {                                                    \
+        statement;                                         \
+      }                                                    \
+    }                                                      \
+    report(F(name), (long)(count) * BENCH_ROUNDS, micros() - start); \
+  }
+
+void report(const __FlashStringHelper *name, long calls, unsigned long us)
+{
+  float ns = us * 1000.0 / calls;
+  Serial.print(F("bench,"));
+  Serial.print(name);
+  Serial.print(',');
+  Serial.print(calls);
+  Serial.print(',');
+  Serial.print(ns, 1);
+  Serial.print(',');
+  Serial.println(ns * (F_CPU / 1000000L) / 1000.0, 1);
+}
+
+// Arduino setup function, called once
+void setup()
+{
+  Serial.begin(XPLDIRECT_BAUDRATE);
+  XP.begin("Bench", &scriptStream);
+
+  // SimVim address pins, mux on pin 38-43
+  DigitalIn.setMux(22, 23, 24, 25);
+  for (int m = 0; m < NUM_MUX; m++)
+  {
+    DigitalIn.addMux(38 + m);
+  }
+
+  for (int n = 0; n < NUM_BUTTONS; n++)
+  {
+    buttons[n] = new Button(n % NUM_MUX, n % 16);
+  }
+  for (int m = 0; m < NUM_MUX; m++)
+  {
+    for (int c = 0; c < 16; c++)
+    {
+      firstButton[m][c] = -1;
+    }
+  }
+  for (int n = BUTTON_PERIOD - 1; n >= 0; n--)
+  {
+    firstButton[n % NUM_MUX][n % 16] = n;
+  }
+  for (int n = 0; n < NUM_SWITCHES; n++)
+  {
+    repeatButtons[n] = new RepeatButton(n % NUM_MUX, n % 16, 250);
+    switches[n] = new Switch(n % NUM_MUX, n % 16);
+    switches2[n] = new Switch2(n % NUM_MUX, n % 16, (n + 1) % 16);
+  }
+  for (int n = 0; n < NUM_ENCODERS; n++)
+  {
+    int pin = (n * 3) % 15;
+    encoders[n] = new Encoder(n % NUM_MUX, pin, pin + 1, NOT_USED, enc4Pulse);
+  }
+  buttons[0]->setCommand(F("sim/autopilot/heading_up"));
+  buttons[1]->setCommand(F("sim/autopilot/heading_down"));
+  buttons[2]->setCommand(F("sim/autopilot/altitude_up"));
+  buttons[3]->setCommand(F("sim/autopilot/altitude_down"));
+  for (int n = 0; n < NUM_DATAREFS; n++)
+  {
+    XP.registerDataRef(F("sim/cockpit/switches/generic"), XPL_WRITE, 100, 1, &values[n], n);
+  }
+  ledShift.setAll(ledFast);
+
+  // handshake with the script stream
+  for (int n = 0; n < 1000 && !XP.allDataRefsRegistered(); n++)
+  {
+    XP.xloop();
+  }
+  if (!XP.allDataRefsRegistered())
+  {
+    Serial.println(F("registration failed, xloop() results are for an unconnected device"));
+  }
+}
+
+// Arduino loop function, one measurement block every 5 seconds
+void loop()
+{
+  Serial.println(F("bench,name,calls,ns,cycles"));
+  BENCH("DigitalIn_::handle", 1, DigitalIn.handle());
+  BENCH("Button::handle", NUM_BUTTONS, buttons[n]->handle());
+  BENCH("RepeatButton::handle", NUM_SWITCHES, repeatButtons[n]->handle());
+  BENCH("Switch::handle", NUM_SWITCHES, switches[n]->handle());
+  BENCH("Switch2::handle", NUM_SWITCHES, switches2[n]->handle());
+  BENCH("Encoder::handle", NUM_ENCODERS, encoders[n]->handle());
+  BENCH("AnalogIn::handle", 1, analog.handle());
+  BENCH("ShiftOut::handle", 1, shiftOut.handle());
+  BENCH("LedShift::handle", 1, ledShift.handle());
+  BENCH("XPLDirect::xloop", 1, XP.xloop());
+  // one complete panel loop as the application would do it
+  BENCH("panel", 1, {
+    DigitalIn.handle();
+    for (int b = 0; b < NUM_BUTTONS; b++)
+      buttons[b]->handle();
+    for (int e = 0; e < NUM_ENCODERS; e++)
+      encoders[e]->handle();
+    XP.xloop();
+  });
+  // same panel with edge driven buttons, needs MUX_EVENT_QUEUE > 0 in platformio.ini. A button is handled
+  // on an event of its input and then every loop until idle(), on an idle panel none at all.
+#if MUX_EVENT_QUEUE > 0
+  BENCH("panel events", 1, {
+    DigitalIn.handle();
+    DigitalInEvent_t event;
+    while (DigitalIn.nextEvent(&event))
+    {
+      for (int b = firstButton[event.expander][event.channel]; b >= 0 && b < NUM_BUTTONS; b += BUTTON_PERIOD)
+      {
+        if (!buttonActive[b])
+        {
+          buttonActive[b] = true;
+          activeButtons[numActive++] = b;
+        }
+      }
+    }
+    for (int a = 0; a < numActive;)
+    {
+      Button *button = buttons[activeButtons[a]];
+      button->handle();
+      if (button->idle())
+      {
+        buttonActive[activeButtons[a]] = false;
+        activeButtons[a] = activeButtons[--numActive];
+      }
+      else
+      {
+        a++;
+      }
+    }
+    for (int e = 0; e < NUM_ENCODERS; e++)
+      encoders[e]->handle();
+    XP.xloop();
+  });
+#endif
+  delay(5000);
+}
@@ -0,0 +1,44 @@
+/*
+  Bench.h - Helpers for the host benchmarks. Results are printed as CSV lines
+  bench,<name>,<parameter>,<value>,<unit> so runs can be collected with grep and compared.
+  Times are host times, useful to compare variants and scaling, not absolute board figures.
+*/
+#ifndef Bench_h
+#define Bench_h
+#include <Arduino.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+inline void benchResult(const char *name, long parameter, double value, const char *unit)
+{
+  printf("bench,%s,%ld,%.3f,%s\n", name, parameter, value, unit);
+}
+
+// time stamp counter for cycle figures of the host, 0 where there is none
+inline unsigned long long benchTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// run body repeatedly for at least minimum us of host time, returns the number of runs and the us taken.
+// The virtual clock of the shim only moves when body advances it.
+template <class Body>
+unsigned long benchRun(Body body, unsigned long minimum, unsigned long *elapsed)
+{
+  unsigned long runs = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  do
+  {
+    body();
+    runs++;
+    *elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  } while (*elapsed < minimum);
+  return runs;
+}
+
+#endif
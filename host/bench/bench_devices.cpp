@@ -0,0 +1,206 @@
+// Per call cost of the device classes on the host, the counterpart of examples/Benchmark for CI: handle() of
+// Button, RepeatButton, Switch, Switch2, Encoder, AnalogIn, ShiftOut and LedShift on 6 mux, with all inputs
+// released and all engaged. The outputs are measured idle and with a change before every call, which shifts out
+// all pins. DigitalIn.handle(), XP.xloop() and the scaled panel loop of the sample run with XP connected to the
+// plugin stand-in, which stays silent after the registration like the script stream of the sample.
+//
+// Reports ns per call and, on x86 hosts, time stamp counter cycles per call. Host figures compare classes and
+// changes of the library, for the loop budget of a board run examples/Benchmark on it.
+#include <XPLDevices.h>
+#include "Bench.h"
+#include "MuxModel.h"
+#include "PluginStandIn.h"
+
+#define NUM_MUX 6
+#define NUM_BUTTONS 200
+#define NUM_SWITCHES 20
+#define NUM_ENCODERS 30
+#define ROUNDS 100 // rounds over all devices of a class per run
+
+static const uint8_t address[4] = {22, 23, 24, 25};
+static const uint8_t data[NUM_MUX] = {38, 39, 40, 41, 42, 43};
+static HostStream link;
+static Button *buttons[NUM_BUTTONS];
+static RepeatButton *repeatButtons[NUM_SWITCHES];
+static Switch *switches[NUM_SWITCHES];
+static Switch2 *switches2[NUM_SWITCHES];
+static Encoder *encoders[NUM_ENCODERS];
+static AnalogIn *analog;
+static ShiftOut *shiftOut;
+static LedShift *ledShift;
+static unsigned long change;
+
+#define NUM_DATAREFS 4 // written datarefs, with the commands of 4 buttons as in the sample
+static long values[NUM_DATAREFS];
+
+static void measure(const char *name, int count, void (*call)(int))
+{
+  unsigned long elapsed;
+  unsigned long long ticks = benchTicks();
+  unsigned long runs = benchRun([&]()
+                                {
+                                  for (int round = 0; round < ROUNDS; round++)
+                                  {
+                                    for (int n = 0; n < count; n++)
+                                    {
+                                      call(n);
+                                    }
+                                  }
+                                },
+                                100000, &elapsed);
+  ticks = benchTicks() - ticks;
+  double calls = (double)runs * ROUNDS * count;
+  char result[48];
+  snprintf(result, sizeof(result), "%s_host", name);
+  benchResult(result, count, elapsed * 1000.0 / calls, "ns/call");
+  if (ticks > 0)
+  {
+    snprintf(result, sizeof(result), "%s_tsc", name);
+    benchResult(result, count, ticks / calls, "cycles/call");
+  }
+}
+
+static void inputs(const char *state, uint16_t engaged)
+{
+  for (int m = 0; m < NUM_MUX; m++)
+  {
+    MuxModel::inputs[m] = engaged;
+  }
+  // debounced into the new state before measuring
+  for (int loop = 0; loop < 100; loop++)
+  {
+    DigitalIn.handle();
+    for (int n = 0; n < NUM_BUTTONS; n++)
+    {
+      buttons[n]->handle();
+    }
+    for (int n = 0; n < NUM_SWITCHES; n++)
+    {
+      repeatButtons[n]->handle();
+      switches[n]->handle();
+      switches2[n]->handle();
+    }
+    for (int n = 0; n < NUM_ENCODERS; n++)
+    {
+      encoders[n]->handle();
+    }
+    hostAdvanceMillis(1);
+  }
+  char name[48];
+  snprintf(name, sizeof(name), "device_button_%s", state);
+  measure(name, NUM_BUTTONS, [](int n)
+          { buttons[n]->handle(); });
+  snprintf(name, sizeof(name), "device_repeatbutton_%s", state);
+  measure(name, NUM_SWITCHES, [](int n)
+          { repeatButtons[n]->handle(); });
+  snprintf(name, sizeof(name), "device_switch_%s", state);
+  measure(name, NUM_SWITCHES, [](int n)
+          { switches[n]->handle(); });
+  snprintf(name, sizeof(name), "device_switch2_%s", state);
+  measure(name, NUM_SWITCHES, [](int n)
+          { switches2[n]->handle(); });
+  snprintf(name, sizeof(name), "device_encoder_%s", state);
+  measure(name, NUM_ENCODERS, [](int n)
+          { encoders[n]->handle(); });
+}
+
+static bool registered()
+{
+  return XP.allDataRefsRegistered() != 0;
+}
+
+// one loop of the scaled panel in the sample
+static void panel(int)
+{
+  DigitalIn.handle();
+  for (int b = 0; b < NUM_BUTTONS; b++)
+  {
+    buttons[b]->handle();
+  }
+  for (int e = 0; e < NUM_ENCODERS; e++)
+  {
+    encoders[e]->handle();
+  }
+  XP.xloop();
+  hostAdvanceMicros(100);
+}
+
+int main()
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Bench", &link);
+  DigitalIn.setMux(address[0], address[1], address[2], address[3]);
+  for (int m = 0; m < NUM_MUX; m++)
+  {
+    DigitalIn.addMux(data[m]);
+  }
+  MuxModel::attach(address, data, NUM_MUX);
+  for (int n = 0; n < NUM_BUTTONS; n++)
+  {
+    buttons[n] = new Button(n % NUM_MUX, n % 16);
+  }
+  for (int n = 0; n < NUM_SWITCHES; n++)
+  {
+    repeatButtons[n] = new RepeatButton(n % NUM_MUX, n % 16, 250);
+    switches[n] = new Switch(n % NUM_MUX, n % 16);
+    switches2[n] = new Switch2(n % NUM_MUX, n % 16, (n + 1) % 16);
+  }
+  for (int n = 0; n < NUM_ENCODERS; n++)
+  {
+    int pin = (n * 3) % 15;
+    encoders[n] = new Encoder(n % NUM_MUX, pin, pin + 1, NOT_USED, enc4Pulse);
+  }
+  analog = new AnalogIn(A0, unipolar, 10);
+  shiftOut = new ShiftOut(8, 9, 10, 32);
+  ledShift = new LedShift(11, 12, 13, 32);
+  hostSetAnalog(A0, 512);
+  buttons[0]->setCommand(F("sim/autopilot/heading_up"));
+  buttons[1]->setCommand(F("sim/autopilot/heading_down"));
+  buttons[2]->setCommand(F("sim/autopilot/altitude_up"));
+  buttons[3]->setCommand(F("sim/autopilot/altitude_down"));
+  for (int n = 0; n < NUM_DATAREFS; n++)
+  {
+    XP.registerDataRef(F("sim/cockpit/switches/generic"), XPL_WRITE, 100, 1, &values[n], n);
+  }
+  PluginStandIn plugin(XP, link);
+  plugin.connect();
+  if (!plugin.runUntil(registered, 2000000))
+  {
+    printf("registration failed\n");
+    return 1;
+  }
+  link.clear();
+
+  // the panel loop on an idle panel, before the inputs are engaged
+  inputs("released", 0);
+  measure("device_digitalin", 1, [](int)
+          { DigitalIn.handle(); });
+  measure("device_xloop", 1, [](int)
+          {
+            XP.xloop();
+            hostAdvanceMicros(100);
+          });
+  measure("device_panel", 1, panel);
+  link.clear();
+  inputs("engaged", 0xFFFF);
+
+  measure("device_analogin", 1, [](int)
+          { analog->handle(); });
+  measure("device_shiftout_idle", 1, [](int)
+          { shiftOut->handle(); });
+  measure("device_shiftout_update", 1, [](int)
+          {
+            shiftOut->setPin(0, ++change & 1);
+            shiftOut->handle();
+          });
+  measure("device_ledshift_idle", 1, [](int)
+          { ledShift->handle(); });
+  measure("device_ledshift_update", 1, [](int)
+          {
+            ledShift->setPin(0, ++change & 1 ? ledOn : ledOff);
+            ledShift->handle();
+          });
+  return 0;
+}
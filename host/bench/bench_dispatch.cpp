@@ -0,0 +1,70 @@
+// Dispatch of incoming dataref updates: frames/s processed by xloop() for 10, 100 and 500 registered datarefs.
+// Built twice, with the handle map and with XPLDIRECT_MAXHANDLES 1, where every lookup is the linear search.
+#include <XPLDevices.h>
+#include "Bench.h"
+
+#define MAX_REFS 500
+#define BATCH_FRAMES 2000
+
+static HostStream link;
+static char names[MAX_REFS][24];
+static long values[MAX_REFS];
+
+static void connect(int count)
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Bench", &link);
+  char frame[40];
+  link.inject("<a>");
+  for (int i = 0; i < count; i++)
+  {
+    snprintf(names[i], sizeof(names[i]), "sim/bench/ref%03d", i);
+    XP.registerDataRef((XPString_t *)names[i], XPL_READ, 100, 1, &values[i]);
+    snprintf(frame, sizeof(frame), "<3%03d%s>", i, names[i]);
+    link.inject(frame);
+  }
+  link.inject("<f>");
+  XP.xloop();
+  link.take();
+}
+
+int main()
+{
+  const char *name = XPLDIRECT_MAXHANDLES > 1 ? "dispatch_map" : "dispatch_linear";
+  const int counts[] = {10, 100, 500};
+  for (int count : counts)
+  {
+    connect(count);
+    if (!XP.allDataRefsRegistered())
+    {
+      printf("registration of %d datarefs failed\n", count);
+      return 1;
+    }
+    // updates spread over all handles, as after a refresh
+    std::string batch;
+    char frame[24];
+    uint32_t seed = 1;
+    for (int f = 0; f < BATCH_FRAMES; f++)
+    {
+      seed = seed * 1103515245 + 12345;
+      snprintf(frame, sizeof(frame), "<e%03d%ld>", (int)(seed >> 8) % count, (long)(seed >> 16) % 10000);
+      batch += frame;
+    }
+    unsigned long elapsed;
+    unsigned long runs = benchRun([&]()
+                                  {
+                                    link.inject(batch.data(), batch.size());
+                                    XP.xloop();
+                                  },
+                                  200000, &elapsed);
+    if (XP.rxDroppedFrames() > 0 || XP.rxMalformedFrames() > 0)
+    {
+      printf("frames lost\n");
+      return 1;
+    }
+    benchResult(name, count, (double)runs * BATCH_FRAMES * 1e6 / elapsed, "frames/s");
+  }
+  return 0;
+}
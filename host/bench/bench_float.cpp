@@ -0,0 +1,94 @@
+// Float conversions of dataref updates: XPLDirect::_formatFloat() against dtostrf() and XPLDirect::_parseFloat()
+// against atof(), over the same values of all magnitudes with the decimals of typical dividers.
+//
+// Host times compare the fixed point routines with the libc of the host, which converts in hardware floating
+// point. On AVR the libc routines work in software float, so the gap there is larger than on the host.
+#include <Arduino.h>
+#include "Bench.h"
+// the conversions are private, this bench is the only place calling them directly
+#define private public
+#include <XPLDirect.h>
+#undef private
+
+#define VALUES 1000
+
+static const byte decimals[] = {0, 1, 2, 3, 6};
+static float values[VALUES];
+static char texts[VALUES][24];
+static volatile long sink;
+
+static uint32_t seed = 4711;
+static uint32_t random32()
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static void measure(const char *name, int parameter, void (*pass)(byte), byte d)
+{
+  unsigned long elapsed;
+  unsigned long runs = benchRun([&]()
+                                { pass(d); },
+                                100000, &elapsed);
+  benchResult(name, parameter, elapsed * 1000.0 / ((double)runs * VALUES), "ns/value");
+}
+
+static void formatLibrary(byte d)
+{
+  char buffer[24];
+  for (int i = 0; i < VALUES; i++)
+  {
+    sink = sink + XP._formatFloat(buffer, values[i], d);
+  }
+}
+
+static void formatDtostrf(byte d)
+{
+  char buffer[48];
+  for (int i = 0; i < VALUES; i++)
+  {
+    dtostrf(values[i], 1, d, buffer);
+    sink = sink + buffer[0];
+  }
+}
+
+static void parseLibrary(byte)
+{
+  for (int i = 0; i < VALUES; i++)
+  {
+    sink = sink + (long)XP._parseFloat(texts[i]);
+  }
+}
+
+static void parseAtof(byte)
+{
+  for (int i = 0; i < VALUES; i++)
+  {
+    sink = sink + (long)atof(texts[i]);
+  }
+}
+
+int main()
+{
+  // magnitudes 1e-4 .. 1e5, the range of panel datarefs
+  for (int i = 0; i < VALUES; i++)
+  {
+    float value = (random32() % 1000000) / 1e5f * powf(10, (int)(random32() % 10) - 4);
+    values[i] = random32() % 2 ? -value : value;
+  }
+  for (byte d : decimals)
+  {
+    measure("float_format_library", d, formatLibrary, d);
+    measure("float_format_dtostrf", d, formatDtostrf, d);
+  }
+  // as the plugin sends them, with 6 decimals
+  for (int i = 0; i < VALUES; i++)
+  {
+    snprintf(texts[i], sizeof(texts[i]), "%f", values[i]);
+  }
+  measure("float_parse_library", 6, parseLibrary, 6);
+  measure("float_parse_atof", 6, parseAtof, 6);
+  return 0;
+}
@@ -0,0 +1,50 @@
+// Time to allDataRefsRegistered() for 10, 50 and 100 datarefs plus as many commands, against a legacy plugin
+// (one registration per poll) and a plugin accepting pipelined registration. Handshake time is virtual time
+// with the link at 115200 baud and a 20 ms flight loop, cpu time is the host time spent in xloop().
+#include <XPLDevices.h>
+#include "Bench.h"
+#include "PluginStandIn.h"
+
+static HostStream link;
+static char dataRefNames[100][32];
+static char commandNames[100][32];
+static long values[100];
+
+static void handshake(const char *name, unsigned long offer, int count)
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Bench", &link);
+  for (int i = 0; i < count; i++)
+  {
+    snprintf(dataRefNames[i], sizeof(dataRefNames[i]), "sim/cockpit2/bench/dataref%03d", i);
+    snprintf(commandNames[i], sizeof(commandNames[i]), "sim/bench/command%03d", i);
+    XP.registerDataRef((XPString_t *)dataRefNames[i], XPL_READ, 100, 1, &values[i]);
+    XP.registerCommand((XPString_t *)commandNames[i]);
+  }
+  PluginStandIn plugin(XP, link);
+  plugin.offer = offer;
+  plugin.connect();
+  if (!plugin.runUntil([]()
+                       { return XP.allDataRefsRegistered() != 0; },
+                       60000000))
+  {
+    printf("%s: handshake of %d datarefs failed\n", name, count);
+    exit(1);
+  }
+  benchResult(name, count, XP.handshakeTime(), "ms");
+  std::string cpu = std::string(name) + "_cpu";
+  benchResult(cpu.c_str(), count, plugin.deviceMicros, "us");
+}
+
+int main()
+{
+  const int counts[] = {10, 50, 100};
+  for (int count : counts)
+  {
+    handshake("handshake_legacy", 0, count);
+    handshake("handshake_pipelined", XPL_CAP_PIPELINE | XPL_CAP_MULTIUPDATE | XPL_CAP_ARRAYBLOCK, count);
+  }
+  return 0;
+}
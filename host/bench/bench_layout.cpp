@@ -0,0 +1,200 @@
+// Dataref table layout: the send scan of xloop() over writable datarefs and the handle map dispatch of incoming
+// updates, with the hot/cold split of XPLDirect against the former interleaved struct. Both layouts are modelled
+// here with the fields of the library, half of the datarefs writable, all values unchanged as on an idle panel.
+// Reports ns per scan and per dispatched update for 10, 100 and 500 datarefs, and the struct sizes.
+#include <XPLDevices.h>
+#include "Bench.h"
+
+#define MAX_REFS 500
+#define DISPATCH_BATCH 1000
+
+// former layout, every field of a dataref in one struct
+struct Interleaved
+{
+  int dataRefHandle;
+  byte dataRefRWType;
+  byte dataRefVARType;
+  float divider;
+  byte forceUpdate;
+  unsigned long updateRate;
+  unsigned long lastUpdateTime;
+  unsigned long nextUpdateTime;
+  const void *dataRefName;
+  unsigned int nameHash;
+  void *latestValue;
+  long int lastSentIntValue;
+  byte updatedFlag;
+  byte arrayIndex;
+  byte registerPending;
+  byte queued;
+  byte dirty;
+  byte explicitDirty;
+};
+
+// split layout, fields used in every loop
+struct Hot
+{
+  int dataRefHandle;
+  byte dataRefVARType : 2;
+  byte decimals : 3;
+  byte forceUpdate : 1;
+  byte updatedFlag : 1;
+  byte queued : 1;
+  byte dirty : 1;
+  byte explicitDirty : 1;
+  float divider;
+  float deadband;
+  float deadbandRelative;
+  unsigned int updateRate;
+  unsigned long nextUpdateTime;
+  void *latestValue;
+  long int lastSentIntValue;
+};
+
+// split layout, fields used for registration only
+struct Cold
+{
+  const void *dataRefName;
+  unsigned int nameHash;
+  byte dataRefRWType;
+  byte arrayIndex;
+  byte arrayCount;
+  byte registerPending;
+  XPLDataRefCallback callback;
+};
+
+static Interleaved interleaved[MAX_REFS];
+static Hot hot[MAX_REFS];
+static Cold cold[MAX_REFS];
+static short writeRefs[MAX_REFS];
+static int writeRefsCount;
+static short handleMap[MAX_REFS];
+static long values[MAX_REFS];
+static int handles[DISPATCH_BATCH];
+static volatile long sink;
+
+static void setup(int count)
+{
+  writeRefsCount = 0;
+  for (int i = 0; i < count; i++)
+  {
+    byte rw = (i % 2) ? XPL_WRITE : XPL_READ;
+    values[i] = i;
+    interleaved[i] = Interleaved();
+    interleaved[i].dataRefHandle = i;
+    interleaved[i].dataRefRWType = rw;
+    interleaved[i].dataRefVARType = XPL_DATATYPE_INT;
+    interleaved[i].latestValue = &values[i];
+    interleaved[i].lastSentIntValue = i;
+    hot[i] = Hot();
+    hot[i].dataRefHandle = i;
+    hot[i].dataRefVARType = XPL_DATATYPE_INT;
+    hot[i].latestValue = &values[i];
+    hot[i].lastSentIntValue = i;
+    cold[i] = Cold();
+    cold[i].dataRefRWType = rw;
+    if (rw == XPL_WRITE)
+    {
+      writeRefs[writeRefsCount++] = i;
+    }
+    handleMap[i] = i;
+  }
+  uint32_t seed = 1;
+  for (int f = 0; f < DISPATCH_BATCH; f++)
+  { // updates for readable datarefs
+    seed = seed * 1103515245 + 12345;
+    handles[f] = ((seed >> 8) % count) & ~1;
+  }
+}
+
+// every dataref is checked for its mode, as the former sweep did
+static long scanInterleaved(int count)
+{
+  long sent = 0;
+  for (int i = 0; i < count; i++)
+  {
+    if ((interleaved[i].dataRefRWType & XPL_WRITE) && interleaved[i].dataRefHandle >= 0 &&
+        *(long *)interleaved[i].latestValue != interleaved[i].lastSentIntValue)
+    {
+      sent++;
+    }
+  }
+  return sent;
+}
+
+static long scanSplit(int count)
+{
+  long sent = 0;
+  for (int w = 0; w < writeRefsCount; w++)
+  {
+    int i = writeRefs[w];
+    if (hot[i].dataRefHandle >= 0 && *(long *)hot[i].latestValue != hot[i].lastSentIntValue)
+    {
+      sent++;
+    }
+  }
+  return sent;
+}
+
+static long dispatchInterleaved(int count)
+{
+  for (int f = 0; f < DISPATCH_BATCH; f++)
+  {
+    int i = handleMap[handles[f]];
+    if (interleaved[i].dataRefRWType != XPL_WRITE)
+    {
+      *(long *)interleaved[i].latestValue = f;
+      interleaved[i].lastSentIntValue = f;
+      interleaved[i].updatedFlag = true;
+    }
+  }
+  return values[0];
+}
+
+static long dispatchSplit(int count)
+{
+  for (int f = 0; f < DISPATCH_BATCH; f++)
+  { // the map only holds readable datarefs
+    int i = handleMap[handles[f]];
+    *(long *)hot[i].latestValue = f;
+    hot[i].lastSentIntValue = f;
+    hot[i].updatedFlag = true;
+  }
+  return values[0];
+}
+
+static void measure(const char *name, int count, long (*pass)(int), int perPass)
+{
+  unsigned long elapsed;
+  unsigned long runs = benchRun([&]()
+                                {
+                                  for (int i = 0; i < 100; i++)
+                                  {
+                                    sink = sink + pass(count);
+                                  }
+                                },
+                                100000, &elapsed);
+  benchResult(name, count, elapsed * 1000.0 / (runs * 100.0 * perPass), perPass > 1 ? "ns/update" : "ns/pass");
+}
+
+int main()
+{
+  benchResult("layout_interleaved_bytes", 1, sizeof(Interleaved), "bytes/dataref");
+  benchResult("layout_hot_bytes", 1, sizeof(Hot), "bytes/dataref");
+  benchResult("layout_cold_bytes", 1, sizeof(Cold), "bytes/dataref");
+  const int counts[] = {10, 100, 500};
+  for (int count : counts)
+  {
+    setup(count);
+    if (scanInterleaved(count) != 0 || scanSplit(count) != 0)
+    {
+      printf("scan of %d datarefs found changes\n", count);
+      return 1;
+    }
+    measure("layout_scan_interleaved", count, scanInterleaved, 1);
+    measure("layout_scan_split", count, scanSplit, 1);
+    measure("layout_dispatch_interleaved", count, dispatchInterleaved, DISPATCH_BATCH);
+    measure("layout_dispatch_split", count, dispatchSplit, DISPATCH_BATCH);
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+// Scan time of DigitalIn_::handle() for 1-6 mux as modeled ATmega2560 cycles and as host time. Built twice:
+// with ARDUINO_ARCH_AVR for the port-wide reads, and without for the digitalRead() path of other boards.
+// The data pins are on one port or spread over four, the address lines on one port.
+//
+// Cycle model: the shim counts digitalRead(), digitalWrite() and the settle time waited, the port reads of the
+// AVR path follow from the ports the data pins are on. Costs per operation are estimates for avr-gcc -Os.
+#include <XPLDevices.h>
+#include "Bench.h"
+#include "MuxModel.h"
+
+#define CYCLES_DIGITALREAD 60      // pin tables in flash, timer check
+#define CYCLES_DIGITALWRITE 70     // as digitalRead, plus SREG save and restore
+#define CYCLES_SAMPLE 15           // bitWrite() of one digitalRead() result and loop
+#define CYCLES_PORT_READ 4         // ld from the input register, st into the sample table
+#define CYCLES_ADDRESS_WRITE 20    // address bits, SREG save, one read-modify-write of the output register
+#define CYCLES_TRANSPOSE 160       // one transpose8(), two per port
+#define CYCLES_SORT 8              // per mux and port in the loop sorting the transposed words out
+#define CYCLES_PER_US (F_CPU / 1000000L)
+
+static const uint8_t address[4] = {24, 25, 26, 27};
+static const uint8_t dataOnePort[6] = {40, 41, 42, 43, 44, 45};
+static const uint8_t dataSpread[6] = {38, 50, 60, 68, 39, 51};
+
+static int ports(const uint8_t *data, int count)
+{
+  int found = 0;
+  uint8_t port[6];
+  for (int m = 0; m < count; m++)
+  {
+    int p = 0;
+    while (p < found && port[p] != digitalPinToPort(data[m]))
+    {
+      p++;
+    }
+    if (p == found)
+    {
+      port[found++] = digitalPinToPort(data[m]);
+    }
+  }
+  return found;
+}
+
+static void measure(const char *layout, const uint8_t *data, int count)
+{
+  hostReset();
+  DigitalIn_ mux;
+  mux.setMux(address[0], address[1], address[2], address[3]);
+  for (int m = 0; m < count; m++)
+  {
+    mux.addMux(data[m]);
+  }
+  MuxModel::attach(address, data, count);
+  mux.handle(); // address lines known from here on
+
+  // one scan for the counters
+  memset(&hostCounters, 0, sizeof(hostCounters));
+  mux.handle();
+  double cycles = hostCounters.digitalRead * (CYCLES_DIGITALREAD + CYCLES_SAMPLE) +
+                  hostCounters.digitalWrite * CYCLES_DIGITALWRITE + hostCounters.delayMicros * CYCLES_PER_US;
+#ifdef ARDUINO_ARCH_AVR
+  int used = ports(data, count);
+  cycles += 16 * (used * CYCLES_PORT_READ + CYCLES_ADDRESS_WRITE) + used * (2 * CYCLES_TRANSPOSE + count * CYCLES_SORT);
+  const char *path = "mux_ports";
+#else
+  const char *path = "mux_digitalread";
+#endif
+  char name[48];
+  snprintf(name, sizeof(name), "%s_%s_cycles", path, layout);
+  benchResult(name, count, cycles, "cycles/scan");
+
+  hostInputHook = NULL; // host time of the library alone
+  unsigned long elapsed;
+  unsigned long runs = benchRun([&]()
+                                {
+                                  for (int i = 0; i < 100; i++)
+                                  {
+                                    mux.handle();
+                                  }
+                                },
+                                100000, &elapsed);
+  snprintf(name, sizeof(name), "%s_%s_host", path, layout);
+  benchResult(name, count, elapsed * 1000.0 / (runs * 100), "ns/scan");
+}
+
+int main()
+{
+  for (int count = 1; count <= 6; count++)
+  {
+    measure("one_port", dataOnePort, count);
+    measure("spread", dataSpread, count);
+  }
+  return 0;
+}
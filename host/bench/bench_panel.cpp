@@ -0,0 +1,214 @@
+// Per-loop cost of a mostly idle panel with 208 buttons on 13 mux: every button polled with handle() each loop,
+// against edge driven buttons, handled on an event of the queue and then every loop until idle(). Both react on
+// pressed() and released(). One input toggles every 1000 loops. The mux scan in DigitalIn.handle() is the same
+// for both and reported on its own.
+//
+// Host times include the mux model, which runs on every digitalRead() of the scan, so the devices are also timed
+// on their own: the part of the loop after DigitalIn.handle(), in ns and on x86 in time stamp counter cycles,
+// both including the calls of the timers.
+// After each run the buttons settle and have to match the inputs, with one transition per toggle.
+#include <XPLDevices.h>
+#include "Bench.h"
+#include "MuxModel.h"
+
+#define MUX 13
+#define INPUTS (MUX * 16)
+#define TOGGLE_LOOPS 1000
+
+static const uint8_t address[4] = {22, 23, 24, 25};
+static const uint8_t data[MUX] = {30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42};
+static Button *buttons[MUX][16];
+static bool toggling;
+static unsigned long loops;
+static unsigned long toggles;
+static unsigned long transitions;
+static unsigned long handled; // Button::handle() calls
+static double deviceNs;
+static unsigned long long deviceTicks;
+
+// edge driven: buttons with a pending event or debounce, as input numbers
+static bool active[INPUTS];
+static int activeList[INPUTS];
+static int activeCount;
+
+// the panel changes state once every TOGGLE_LOOPS loops
+static void panel()
+{
+  if (++loops % TOGGLE_LOOPS == 0 && toggling)
+  {
+    int input = (loops / TOGGLE_LOOPS) % INPUTS;
+    MuxModel::inputs[input / 16] ^= 1 << (input % 16);
+    toggles++;
+  }
+}
+
+// reaction of the application
+static void react(Button *button)
+{
+  if (button->pressed())
+  {
+    transitions++;
+  }
+  if (button->released())
+  {
+    transitions++;
+  }
+}
+
+static void polledDevices()
+{
+  for (int m = 0; m < MUX; m++)
+  {
+    for (int channel = 0; channel < 16; channel++)
+    {
+      buttons[m][channel]->handle();
+      react(buttons[m][channel]);
+      handled++;
+    }
+  }
+}
+
+static void edgeDevices()
+{
+  DigitalInEvent_t event;
+  while (DigitalIn.nextEvent(&event))
+  {
+    int input = event.expander * 16 + event.channel;
+    if (!active[input])
+    {
+      active[input] = true;
+      activeList[activeCount++] = input;
+    }
+  }
+  for (int a = 0; a < activeCount;)
+  {
+    int input = activeList[a];
+    Button *button = buttons[input / 16][input % 16];
+    button->handle();
+    react(button);
+    handled++;
+    if (button->idle())
+    {
+      active[input] = false;
+      activeList[a] = activeList[--activeCount];
+    }
+    else
+    {
+      a++;
+    }
+  }
+}
+
+static void (*devices)();
+
+static void panelLoop()
+{
+  panel();
+  DigitalIn.handle();
+  if (devices == NULL)
+  {
+    return;
+  }
+  unsigned long long ticks = benchTicks();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  devices();
+  deviceNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  deviceTicks += benchTicks() - ticks;
+}
+
+// loops without toggles until every debounce is done
+static void settle()
+{
+  for (int i = 0; i < 100; i++)
+  {
+    panelLoop();
+  }
+}
+
+static bool measure(const char *name, void (*loopDevices)())
+{
+  devices = loopDevices;
+  toggling = false;
+  settle();
+  loops = toggles = transitions = handled = 0;
+  deviceNs = 0;
+  deviceTicks = 0;
+  toggling = true;
+  unsigned long elapsed;
+  unsigned long runs = benchRun([&]()
+                                {
+                                  for (int i = 0; i < 100; i++)
+                                  {
+                                    panelLoop();
+                                  }
+                                },
+                                200000, &elapsed);
+  double count = runs * 100.0;
+  char result[48];
+  snprintf(result, sizeof(result), "panel_%s_host", name);
+  benchResult(result, INPUTS, elapsed * 1000.0 / count, "ns/loop");
+  if (devices == NULL)
+  {
+    return true;
+  }
+  snprintf(result, sizeof(result), "panel_%s_handled", name);
+  benchResult(result, INPUTS, handled / count, "buttons/loop");
+  snprintf(result, sizeof(result), "panel_%s_devices_host", name);
+  benchResult(result, INPUTS, deviceNs / count, "ns/loop");
+  if (deviceTicks > 0)
+  {
+    snprintf(result, sizeof(result), "panel_%s_devices_tsc", name);
+    benchResult(result, INPUTS, deviceTicks / count, "cycles/loop");
+  }
+
+  // every toggle was seen and the buttons follow the inputs
+  toggling = false;
+  settle();
+  bool ok = transitions == toggles;
+  for (int input = 0; input < INPUTS; input++)
+  {
+    ok = ok && buttons[input / 16][input % 16]->engaged() == ((MuxModel::inputs[input / 16] >> (input % 16)) & 1);
+  }
+  if (!ok)
+  {
+    printf("%s: %lu transitions for %lu toggles, or buttons not following the inputs\n", name, transitions, toggles);
+  }
+  return ok;
+}
+
+int main()
+{
+  hostReset();
+  DigitalIn.setMux(address[0], address[1], address[2], address[3]);
+  for (int m = 0; m < MUX; m++)
+  {
+    DigitalIn.addMux(data[m]);
+    for (int channel = 0; channel < 16; channel++)
+    {
+      buttons[m][channel] = new Button(m, channel);
+    }
+  }
+  MuxModel::attach(address, data, MUX);
+
+  measure("scan", NULL);
+  if (!measure("polled", polledDevices))
+  {
+    return 1;
+  }
+  // the queue filled up while nobody read it, the buttons follow the inputs from the polled run
+  DigitalInEvent_t event;
+  while (DigitalIn.nextEvent(&event))
+  {
+  }
+  unsigned int dropped = DigitalIn.eventsDropped();
+  if (!measure("edge", edgeDevices))
+  {
+    return 1;
+  }
+  if (DigitalIn.eventsDropped() != dropped)
+  {
+    printf("%u events dropped\n", DigitalIn.eventsDropped() - dropped);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+// Bytes on the wire for the handshake and for float updates in both directions, with a legacy plugin,
+// a plugin accepting multi updates and one accepting binary frames.
+#include <XPLDevices.h>
+#include "Bench.h"
+#include "PluginStandIn.h"
+
+#define REFS 10
+#define COMMANDS 10
+#define ROUNDS 100
+
+static HostStream link;
+static char readNames[REFS][40];
+static char writeNames[REFS][40];
+static char commandNames[COMMANDS][40];
+static float readValues[REFS];
+static float writeValues[REFS];
+
+static void measure(const char *mode, unsigned long offer)
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Bench", &link);
+  for (int i = 0; i < REFS; i++)
+  {
+    snprintf(readNames[i], sizeof(readNames[i]), "sim/cockpit2/gauges/indicators/read%d", i);
+    snprintf(writeNames[i], sizeof(writeNames[i]), "sim/cockpit2/controls/write%d", i);
+    XP.registerDataRef((XPString_t *)readNames[i], XPL_READ, 100, 1, &readValues[i]);
+    XP.registerDataRef((XPString_t *)writeNames[i], XPL_WRITE, 0, 0.01, &writeValues[i]);
+  }
+  for (int i = 0; i < COMMANDS; i++)
+  {
+    snprintf(commandNames[i], sizeof(commandNames[i]), "sim/bench/command%d", i);
+    XP.registerCommand((XPString_t *)commandNames[i]);
+  }
+  PluginStandIn plugin(XP, link);
+  plugin.offer = offer;
+  plugin.connect();
+  plugin.runUntil([]()
+                  { return XP.allDataRefsRegistered() != 0; },
+                  10000000);
+  plugin.run(100000);
+  char name[64];
+  snprintf(name, sizeof(name), "wire_handshake_%s", mode);
+  benchResult(name, REFS * 2 + COMMANDS, plugin.bytesToDevice + plugin.bytesFromDevice, "bytes");
+
+  // every flight loop the plugin updates all read datarefs and the panel changes all written ones
+  unsigned long toDevice = 0;
+  unsigned long fromDevice = plugin.bytesFromDevice;
+  unsigned long noRequests = plugin.noRequests;
+  unsigned long updates = 0;
+  for (int h = 0; h < (int)plugin.dataRefs.size(); h++)
+  {
+    updates -= plugin.dataRefs[h].updates;
+  }
+  for (int round = 0; round < ROUNDS; round++)
+  {
+    for (int i = 0; i < REFS; i++)
+    {
+      unsigned long before = plugin.bytesToDevice;
+      plugin.updateFloat(plugin.dataRefHandle(readNames[i]), 1000.0f * i + round * 0.25f);
+      toDevice += plugin.bytesToDevice - before;
+      writeValues[i] = 0.5f * round + i;
+    }
+    plugin.run(plugin.flightLoopMicros);
+  }
+  plugin.run(100000);
+  for (int h = 0; h < (int)plugin.dataRefs.size(); h++)
+  {
+    updates += plugin.dataRefs[h].updates;
+  }
+  fromDevice = plugin.bytesFromDevice - fromDevice - (plugin.noRequests - noRequests) * (plugin.binary ? 4 : 3);
+  snprintf(name, sizeof(name), "wire_to_device_%s", mode);
+  benchResult(name, ROUNDS * REFS, (double)toDevice / (ROUNDS * REFS), "bytes/update");
+  snprintf(name, sizeof(name), "wire_to_plugin_%s", mode);
+  benchResult(name, updates, (double)fromDevice / updates, "bytes/update");
+}
+
+int main()
+{
+  measure("legacy", 0);
+  measure("multi", XPL_CAP_PIPELINE | XPL_CAP_MULTIUPDATE);
+  measure("binary", XPL_CAP_PIPELINE | XPL_CAP_MULTIUPDATE | XPL_CAP_BINARY);
+  return 0;
+}
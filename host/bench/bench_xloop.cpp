@@ -0,0 +1,77 @@
+// Cost of xloop() against the number of written datarefs: polled datarefs with rate 0 are checked every
+// millisecond, datarefs using markDirty() only when marked. Host time per xloop() call, with the sketch
+// looping every 100 us of virtual time.
+#include <XPLDevices.h>
+#include "Bench.h"
+
+#define MAX_REFS 500
+#define LOOPS 100
+
+static HostStream link;
+static char names[MAX_REFS][24];
+static long values[MAX_REFS];
+
+static void connect(int count, bool marked)
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Bench", &link);
+  char frame[40];
+  link.inject("<a>");
+  for (int i = 0; i < count; i++)
+  {
+    snprintf(names[i], sizeof(names[i]), "sim/bench/ref%03d", i);
+    int handle = XP.registerDataRef((XPString_t *)names[i], XPL_WRITE, 0, 1, &values[i]);
+    if (marked)
+    {
+      XP.markDirty(handle);
+    }
+    snprintf(frame, sizeof(frame), "<3%03d%s>", i, names[i]);
+    link.inject(frame);
+  }
+  link.inject("<f>");
+  XP.xloop();
+  link.clear();
+}
+
+static void measure(const char *name, int count, bool marked, bool active)
+{
+  connect(count, marked);
+  if (!XP.allDataRefsRegistered())
+  {
+    printf("registration of %d datarefs failed\n", count);
+    exit(1);
+  }
+  int next = 0;
+  unsigned long elapsed;
+  unsigned long runs = benchRun([&]()
+                                {
+                                  for (int loop = 0; loop < LOOPS; loop++)
+                                  {
+                                    if (active)
+                                    { // one input changes per loop
+                                      values[next]++;
+                                      XP.markDirty(next);
+                                      next = (next + 1) % count;
+                                    }
+                                    XP.xloop();
+                                    hostAdvanceMicros(100);
+                                  }
+                                  link.clear();
+                                },
+                                200000, &elapsed);
+  benchResult(name, count, elapsed * 1000.0 / (runs * LOOPS), "ns/loop");
+}
+
+int main()
+{
+  const int counts[] = {10, 100, 500};
+  for (int count : counts)
+  {
+    measure("xloop_polled", count, false, false);
+    measure("xloop_marked_idle", count, true, false);
+    measure("xloop_marked_active", count, true, true);
+  }
+  return 0;
+}
@@ -0,0 +1,41 @@
+/*
+  Adafruit_MCP23X17.h - The part of the Adafruit MCP23017 library used by DigitalIn, on the Wire shim.
+  Bus transactions are the same as with the library: begin_I2C() probes the address, readGPIOAB()
+  writes the register address and reads both ports.
+*/
+#ifndef Adafruit_MCP23X17_h
+#define Adafruit_MCP23X17_h
+
+#include <Arduino.h>
+#include <Wire.h>
+
+class Adafruit_MCP23X17
+{
+public:
+  bool begin_I2C(uint8_t address = 0x20, TwoWire *wire = &Wire)
+  {
+    _address = address;
+    _wire = wire;
+    _wire->begin();
+    _wire->beginTransmission(_address);
+    return _wire->endTransmission() == 0;
+  }
+
+  uint16_t readGPIOAB()
+  {
+    _wire->beginTransmission(_address);
+    _wire->write(0x12); // GPIOA
+    if (_wire->endTransmission(false) != 0 || _wire->requestFrom(_address, (size_t)2) != 2)
+    {
+      return 0;
+    }
+    uint16_t value = _wire->read();
+    return value | (_wire->read() << 8);
+  }
+
+private:
+  uint8_t _address = 0x20;
+  TwoWire *_wire = &Wire;
+};
+
+#endif
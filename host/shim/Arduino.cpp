@@ -0,0 +1,340 @@
+#include <Arduino.h>
+#include <chrono>
+
+volatile uint8_t hostPortInput[HOST_PORTS];
+volatile uint8_t hostPortOutput[HOST_PORTS];
+volatile uint8_t SREG = 0x80;
+void (*hostInputHook)() = NULL;
+HostCounters hostCounters;
+HardwareSerial Serial;
+
+static unsigned long long _clock;  // virtual time in us
+static unsigned long long _offset; // added in realtime mode by delay()
+static bool _realtime;
+static int _analog[HOST_PINS];
+
+static unsigned long long _now()
+{
+  if (_realtime)
+  {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() + _offset;
+  }
+  return _clock;
+}
+
+unsigned long millis()
+{
+  return (unsigned long)(_now() / 1000);
+}
+
+unsigned long micros()
+{
+  return (unsigned long)_now();
+}
+
+void delay(unsigned long ms)
+{
+  hostAdvanceMicros(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  hostCounters.delayMicros += us;
+  hostAdvanceMicros(us);
+  if (hostInputHook != NULL)
+  {
+    hostInputHook();
+  }
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin < HOST_PINS && mode == INPUT_PULLUP)
+  { // open inputs read high
+    hostPortInput[digitalPinToPort(pin)] |= digitalPinToBitMask(pin);
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  hostCounters.digitalRead++;
+  if (hostInputHook != NULL)
+  {
+    hostInputHook();
+  }
+  if (pin >= HOST_PINS)
+  {
+    return LOW;
+  }
+  return (hostPortInput[digitalPinToPort(pin)] & digitalPinToBitMask(pin)) ? HIGH : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  hostCounters.digitalWrite++;
+  if (pin >= HOST_PINS)
+  {
+    return;
+  }
+  if (value)
+  {
+    hostPortOutput[digitalPinToPort(pin)] |= digitalPinToBitMask(pin);
+  }
+  else
+  {
+    hostPortOutput[digitalPinToPort(pin)] &= ~digitalPinToBitMask(pin);
+  }
+}
+
+int analogRead(uint8_t pin)
+{
+  hostCounters.analogRead++;
+  return pin < HOST_PINS ? _analog[pin] : 0;
+}
+
+void hostReset()
+{
+  _clock = 0;
+  _offset = 0;
+  _realtime = false;
+  memset((void *)hostPortInput, 0, sizeof(hostPortInput));
+  memset((void *)hostPortOutput, 0, sizeof(hostPortOutput));
+  memset(_analog, 0, sizeof(_analog));
+  memset(&hostCounters, 0, sizeof(hostCounters));
+  SREG = 0x80;
+  hostInputHook = NULL;
+}
+
+void hostAdvanceMicros(unsigned long us)
+{
+  if (_realtime)
+  {
+    _offset += us;
+  }
+  else
+  {
+    _clock += us;
+  }
+}
+
+void hostRealtimeClock(bool enable)
+{
+  _realtime = enable;
+}
+
+void hostSetPin(uint8_t pin, bool level)
+{
+  if (pin < HOST_PINS)
+  {
+    if (level)
+    {
+      hostPortInput[digitalPinToPort(pin)] |= digitalPinToBitMask(pin);
+    }
+    else
+    {
+      hostPortInput[digitalPinToPort(pin)] &= ~digitalPinToBitMask(pin);
+    }
+  }
+}
+
+bool hostGetPin(uint8_t pin)
+{
+  return pin < HOST_PINS && (hostPortOutput[digitalPinToPort(pin)] & digitalPinToBitMask(pin));
+}
+
+void hostSetAnalog(uint8_t pin, int value)
+{
+  if (pin < HOST_PINS)
+  {
+    _analog[pin] = value;
+  }
+}
+
+// AVR libc conversions
+
+char *dtostrf(double value, signed char width, unsigned char precision, char *buffer)
+{
+  sprintf(buffer, "%*.*f", width, precision, value);
+  return buffer;
+}
+
+char *ultoa(unsigned long value, char *buffer, int radix)
+{
+  char tmp[sizeof(unsigned long) * 8 + 1];
+  int length = 0;
+  do
+  {
+    int digit = value % radix;
+    tmp[length++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= radix;
+  } while (value > 0);
+  for (int i = 0; i < length; i++)
+  {
+    buffer[i] = tmp[length - 1 - i];
+  }
+  buffer[length] = 0;
+  return buffer;
+}
+
+char *ltoa(long value, char *buffer, int radix)
+{
+  if (value < 0 && radix == 10)
+  {
+    buffer[0] = '-';
+    ultoa(-(unsigned long)value, buffer + 1, radix);
+    return buffer;
+  }
+  return ultoa((unsigned long)value, buffer, radix);
+}
+
+char *itoa(int value, char *buffer, int radix)
+{
+  return ltoa(value, buffer, radix);
+}
+
+// Print
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t count = 0;
+  while (size-- > 0)
+  {
+    count += write(*buffer++);
+  }
+  return count;
+}
+
+size_t Print::print(long value)
+{
+  char tmp[24];
+  return write(ltoa(value, tmp, 10));
+}
+
+size_t Print::print(unsigned long value)
+{
+  char tmp[24];
+  return write(ultoa(value, tmp, 10));
+}
+
+size_t Print::print(double value, int digits)
+{
+  char tmp[48];
+  snprintf(tmp, sizeof(tmp), "%.*f", digits, value);
+  return write(tmp);
+}
+
+// HostStream
+
+HostStream::~HostStream()
+{
+  free(_rx);
+  free(_tx);
+}
+
+void HostStream::inject(const void *data, size_t length)
+{
+  if (_rxPos > 0)
+  { // drop data already read
+    memmove(_rx, _rx + _rxPos, _rxLength - _rxPos);
+    _rxLength -= _rxPos;
+    _rxPos = 0;
+  }
+  if (_rxLength + length > _rxSize)
+  {
+    _rxSize = (_rxLength + length) * 2;
+    _rx = (uint8_t *)realloc(_rx, _rxSize);
+  }
+  memcpy(_rx + _rxLength, data, length);
+  _rxLength += length;
+}
+
+const char *HostStream::take(size_t *length)
+{
+  if (_takeLength > 0)
+  { // drop data returned by the last call
+    memmove(_tx, _tx + _takeLength, _txLength - _takeLength);
+    _txLength -= _takeLength;
+  }
+  if (_tx == NULL || _txLength + 1 > _txSize)
+  {
+    _txSize = _txLength + 64;
+    _tx = (char *)realloc(_tx, _txSize);
+  }
+  _tx[_txLength] = 0;
+  _takeLength = _txLength;
+  if (length != NULL)
+  {
+    *length = _txLength;
+  }
+  return _tx;
+}
+
+void HostStream::clear()
+{
+  _rxLength = _rxPos = 0;
+  _txLength = _takeLength = 0;
+  writeCalls = writeCalls64 = 0;
+}
+
+size_t HostStream::write(const uint8_t *buffer, size_t size)
+{
+  writeCalls++;
+  if (size == 64)
+  {
+    writeCalls64++;
+  }
+  if (_txLength + size + 1 > _txSize)
+  {
+    _txSize = (_txLength + size + 1) * 2;
+    _tx = (char *)realloc(_tx, _txSize);
+  }
+  memcpy(_tx + _txLength, buffer, size);
+  _txLength += size;
+  return size;
+}
+
+// HostFile
+
+void HostFile::close()
+{
+  if (_file != NULL)
+  {
+    fclose(_file);
+    _file = NULL;
+  }
+}
+
+std::vector<uint8_t> HostFile::load(const char *path)
+{
+  std::vector<uint8_t> data;
+  HostFile file(path, "rb");
+  for (int c; (c = file.read()) >= 0;)
+  {
+    data.push_back(c);
+  }
+  return data;
+}
+
+int HostFile::available()
+{
+  if (_file == NULL)
+  {
+    return 0;
+  }
+  long pos = ftell(_file);
+  fseek(_file, 0, SEEK_END);
+  long end = ftell(_file);
+  fseek(_file, pos, SEEK_SET);
+  return (int)(end - pos);
+}
+
+int HostFile::peek()
+{
+  int c = read();
+  if (c >= 0)
+  {
+    ungetc(c, _file);
+  }
+  return c;
+}
@@ -0,0 +1,268 @@
+/*
+  Arduino.h - Minimal Arduino shim to build XPLDevices on the host for tests and benchmarks.
+  Covers only what the library and its examples use. Pins are grouped into emulated AVR style
+  ports of 8 pins each, so code using digitalRead() and code using the port registers directly
+  see the same inputs and outputs. Time comes from a virtual clock that only moves when told to.
+*/
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef F_CPU
+#define F_CPU 16000000L // cycle figures of the benchmarks are given for an ATmega2560
+#endif
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LED_BUILTIN 13
+
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define A5 59
+#define A6 60
+#define A7 61
+
+#define HOST_PINS 72
+#define HOST_PORTS (HOST_PINS / 8 + 1)
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// macros like the AVR core, the library uses min and max also as parameter names. Standard headers
+// used by tests are included before, as they would not compile after the macros.
+#ifdef __cplusplus
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#endif
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+// Flash strings are plain strings on the host
+class __FlashStringHelper;
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define memcpy_P memcpy
+
+// AVR libc conversions
+char *dtostrf(double value, signed char width, unsigned char precision, char *buffer);
+char *ltoa(long value, char *buffer, int radix);
+char *ultoa(unsigned long value, char *buffer, int radix);
+char *itoa(int value, char *buffer, int radix);
+
+// time, virtual unless hostRealtimeClock() is enabled
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// digital and analog pins
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int analogRead(uint8_t pin);
+
+// emulated port registers, SREG with the global interrupt flag in bit 7
+extern volatile uint8_t hostPortInput[HOST_PORTS];
+extern volatile uint8_t hostPortOutput[HOST_PORTS];
+extern volatile uint8_t SREG;
+#define NOT_A_PORT 0
+#define digitalPinToPort(pin) ((pin) < HOST_PINS ? (pin) / 8 + 1 : NOT_A_PORT)
+#define digitalPinToBitMask(pin) (1 << ((pin) % 8))
+#define portInputRegister(port) (&hostPortInput[port])
+#define portOutputRegister(port) (&hostPortOutput[port])
+inline void noInterrupts() { SREG &= ~0x80; }
+inline void interrupts() { SREG |= 0x80; }
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t data) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str == NULL ? 0 : write((const uint8_t *)str, strlen(str)); }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual int availableForWrite() { return 0; } // like the Arduino core, streams have to override it
+  virtual void flush() {}
+
+  size_t print(const __FlashStringHelper *str) { return write((const char *)str); }
+  size_t print(const char *str) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value) { return print((long)value); }
+  size_t print(unsigned int value) { return print((unsigned long)value); }
+  size_t print(long value);
+  size_t print(unsigned long value);
+  size_t print(double value, int digits = 2);
+  size_t println() { return write("\r\n"); }
+  template <class T>
+  size_t println(T value) { return print(value) + println(); }
+  size_t println(double value, int digits) { return print(value, digits) + println(); }
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+
+protected:
+  unsigned long _timeout = 1000;
+};
+
+/// @brief Stream in memory: received data is injected by the test, sent data collected
+class HostStream : public Stream
+{
+public:
+  /// @brief Add data to be received
+  void inject(const void *data, size_t length);
+  void inject(const char *str) { inject(str, strlen(str)); }
+
+  /// @brief Sent data since the last call, as nul terminated string (may contain further nul bytes)
+  /// @param length Receives the number of bytes when not NULL
+  const char *take(size_t *length = NULL);
+
+  /// @brief Discard all data in both directions
+  void clear();
+
+  /// @brief Value reported by availableForWrite(), negative for the Print default of 0
+  int writeSpace = -1;
+
+  /// @brief Number of write calls and calls with exactly 64 bytes
+  unsigned long writeCalls = 0;
+  unsigned long writeCalls64 = 0;
+
+  int available() { return (int)(_rxLength - _rxPos); }
+  int read() { return _rxPos < _rxLength ? _rx[_rxPos++] : -1; }
+  int peek() { return _rxPos < _rxLength ? _rx[_rxPos] : -1; }
+  size_t write(uint8_t data) { return write(&data, 1); }
+  size_t write(const uint8_t *buffer, size_t size);
+  int availableForWrite() { return writeSpace < 0 ? Print::availableForWrite() : writeSpace; }
+  using Print::write;
+
+  HostStream() {}
+  HostStream(const HostStream &) = delete;
+  ~HostStream();
+
+private:
+  uint8_t *_rx = NULL;
+  size_t _rxLength = 0;
+  size_t _rxPos = 0;
+  size_t _rxSize = 0;
+  char *_tx = NULL;
+  size_t _txLength = 0;
+  size_t _txSize = 0;
+  size_t _takeLength = 0;
+};
+
+/// @brief Stream on a file, e.g. to dump an XPLCapture during a test and load it for XPLReplay
+class HostFile : public Stream
+{
+public:
+  /// @brief Open path with an fopen() mode, "rb" to read and "wb" to write
+  HostFile(const char *path, const char *mode) { _file = fopen(path, mode); }
+  HostFile(const HostFile &) = delete;
+  ~HostFile() { close(); }
+
+  bool isOpen() { return _file != NULL; }
+  void close();
+
+  /// @brief Whole content of a file, empty if it cannot be read
+  static std::vector<uint8_t> load(const char *path);
+
+  int available();
+  int read() { return _file == NULL ? -1 : fgetc(_file); }
+  int peek();
+  size_t write(uint8_t data) { return write(&data, 1); }
+  size_t write(const uint8_t *buffer, size_t size) { return _file == NULL ? 0 : fwrite(buffer, 1, size, _file); }
+  int availableForWrite() { return _file == NULL ? 0 : 64; }
+  void flush()
+  {
+    if (_file != NULL)
+      fflush(_file);
+  }
+  using Print::write;
+
+private:
+  FILE *_file;
+};
+
+class HardwareSerial : public HostStream
+{
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  void end() {}
+};
+
+extern HardwareSerial Serial;
+
+// control of the emulation by tests and benchmarks
+
+/// @brief Reset clock, pins and counters
+void hostReset();
+
+/// @brief Advance the virtual clock
+void hostAdvanceMicros(unsigned long us);
+inline void hostAdvanceMillis(unsigned long ms) { hostAdvanceMicros(ms * 1000); }
+
+/// @brief Let millis() and micros() follow the real clock, used by benchmarks. delay() does not sleep in either mode.
+void hostRealtimeClock(bool enable);
+
+/// @brief Set the level an input pin reads
+void hostSetPin(uint8_t pin, bool level);
+
+/// @brief Level of an output pin
+bool hostGetPin(uint8_t pin);
+
+/// @brief Set the value analogRead() returns for pin
+void hostSetAnalog(uint8_t pin, int value);
+
+/// @brief Called before inputs are sampled (digitalRead) and during delayMicroseconds(), e.g. to let
+/// a model of external hardware react on the outputs. Code reading the port registers directly
+/// only sees the update when it waits with delayMicroseconds() before.
+extern void (*hostInputHook)();
+
+/// @brief Calls of the pin and I2C functions since hostReset(), for cycle models
+struct HostCounters
+{
+  unsigned long digitalRead;
+  unsigned long digitalWrite;
+  unsigned long analogRead;
+  unsigned long delayMicros; // total us waited
+  unsigned long i2cTransmissions; // Wire.endTransmission() calls
+  unsigned long i2cRequests;      // Wire.requestFrom() calls
+  unsigned long i2cBytes;         // bytes written and read on the bus
+};
+extern HostCounters hostCounters;
+
+#endif
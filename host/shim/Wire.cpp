@@ -0,0 +1,78 @@
+#include "Wire.h"
+
+TwoWire Wire;
+
+void TwoWire::hostAttach(HostWireDevice *device)
+{
+  if (_numDevices < (int)(sizeof(_devices) / sizeof(_devices[0])))
+  {
+    _devices[_numDevices++] = device;
+  }
+}
+
+HostWireDevice *TwoWire::_device(uint8_t address)
+{
+  for (int i = 0; i < _numDevices; i++)
+  {
+    if (_devices[i]->address() == address)
+    {
+      return _devices[i];
+    }
+  }
+  return NULL;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+  _txAddress = address;
+  _txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  if (_txLength >= sizeof(_tx))
+  {
+    return 0;
+  }
+  _tx[_txLength++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *buffer, size_t size)
+{
+  size_t written = 0;
+  while (written < size && write(buffer[written]))
+  {
+    written++;
+  }
+  return written;
+}
+
+uint8_t TwoWire::endTransmission(bool stop)
+{
+  (void)stop;
+  hostCounters.i2cTransmissions++;
+  hostCounters.i2cBytes += _txLength;
+  HostWireDevice *device = _device(_txAddress);
+  if (device == NULL)
+  {
+    return 2;
+  }
+  device->received(_tx, _txLength);
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool stop)
+{
+  (void)stop;
+  hostCounters.i2cRequests++;
+  _rxPos = 0;
+  _rxLength = 0;
+  HostWireDevice *device = _device(address);
+  if (device != NULL)
+  {
+    _rxLength = device->requested(_rx, min(quantity, sizeof(_rx)));
+  }
+  hostCounters.i2cBytes += _rxLength;
+  return (uint8_t)_rxLength;
+}
@@ -0,0 +1,63 @@
+/*
+  Wire.h - I2C bus of the host shim. Transmissions and requests go to the devices attached by the test,
+  e.g. a model of an MCP23017, and are counted in hostCounters like the pin functions.
+*/
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include <Arduino.h>
+
+/// @brief Device on the emulated I2C bus
+class HostWireDevice
+{
+public:
+  virtual ~HostWireDevice() {}
+  /// @brief 7 bit address
+  virtual uint8_t address() = 0;
+  /// @brief Bytes of one transmission, from beginTransmission() to endTransmission()
+  virtual void received(const uint8_t *data, size_t length) = 0;
+  /// @brief Bytes for requestFrom(), returns the number of bytes provided
+  virtual size_t requested(uint8_t *data, size_t length) = 0;
+};
+
+class TwoWire : public Stream
+{
+public:
+  void begin() {}
+  void setClock(uint32_t clock) { (void)clock; }
+
+  void beginTransmission(uint8_t address);
+  /// @brief 0 when sent, 2 when no device acknowledged the address (like the AVR core)
+  uint8_t endTransmission(bool stop = true);
+  uint8_t requestFrom(uint8_t address, size_t quantity, bool stop = true);
+
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *buffer, size_t size);
+  // like the AVR core, so write(0x00) is not ambiguous
+  size_t write(int data) { return write((uint8_t)data); }
+  size_t write(unsigned int data) { return write((uint8_t)data); }
+  int available() { return (int)(_rxLength - _rxPos); }
+  int read() { return _rxPos < _rxLength ? _rx[_rxPos++] : -1; }
+  int peek() { return _rxPos < _rxLength ? _rx[_rxPos] : -1; }
+  using Print::write;
+
+  /// @brief Connect a device to the bus, devices stay attached until hostDetachAll()
+  void hostAttach(HostWireDevice *device);
+  void hostDetachAll() { _numDevices = 0; }
+
+private:
+  HostWireDevice *_device(uint8_t address);
+
+  HostWireDevice *_devices[8];
+  int _numDevices = 0;
+  uint8_t _txAddress = 0;
+  uint8_t _tx[32]; // buffer size of the AVR core
+  size_t _txLength = 0;
+  uint8_t _rx[32];
+  size_t _rxLength = 0;
+  size_t _rxPos = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
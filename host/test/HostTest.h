@@ -0,0 +1,58 @@
+/*
+  HostTest.h - Minimal check macros for the host tests, a failed check is reported and the test continues.
+  Each test is a program returning hostTestResult() from main(), registered with ctest.
+*/
+#ifndef HostTest_h
+#define HostTest_h
+#include <Arduino.h>
+
+static int hostTestChecks;
+static int hostTestFailures;
+
+#define CHECK(condition)                                                     \
+  do                                                                         \
+  {                                                                          \
+    hostTestChecks++;                                                        \
+    if (!(condition))                                                        \
+    {                                                                        \
+      hostTestFailures++;                                                    \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+    }                                                                        \
+  } while (0)
+
+#define CHECK_EQUAL(expected, actual)                                                              \
+  do                                                                                               \
+  {                                                                                                \
+    hostTestChecks++;                                                                              \
+    long long _e = (long long)(expected);                                                          \
+    long long _a = (long long)(actual);                                                            \
+    if (_e != _a)                                                                                  \
+    {                                                                                              \
+      hostTestFailures++;                                                                          \
+      printf("%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #expected, \
+             #actual, _e, _a);                                                                     \
+    }                                                                                              \
+  } while (0)
+
+#define CHECK_STRING(expected, actual)                                                         \
+  do                                                                                           \
+  {                                                                                            \
+    hostTestChecks++;                                                                          \
+    const char *_e = (expected);                                                               \
+    const char *_a = (actual);                                                                 \
+    if (strcmp(_e, _a) != 0)                                                                   \
+    {                                                                                          \
+      hostTestFailures++;                                                                      \
+      printf("%s:%d: check failed: %s\n  expected \"%s\"\n  actual   \"%s\"\n", __FILE__, \
+             __LINE__, #actual, _e, _a);                                                       \
+    }                                                                                          \
+  } while (0)
+
+// summary line and exit code for ctest
+inline int hostTestResult()
+{
+  printf("%d checks, %d failed\n", hostTestChecks, hostTestFailures);
+  return hostTestFailures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,128 @@
+/*
+  McpModel.h - MCP23017 on the Wire bus of the host shim, with the registers DigitalIn uses: IODIR, IPOL,
+  GPINTEN, GPPU, INTF, INTCAP and GPIO with sequential addressing. Interrupts are on change from the
+  previous value with INTA and INTB mirrored, as DigitalIn configures them. The interrupt output drives
+  an Arduino pin, the open drain outputs of several models on the same pin are combined.
+*/
+#ifndef McpModel_h
+#define McpModel_h
+#include <Wire.h>
+
+#define MCP_MODEL_GPINTENA 0x04
+#define MCP_MODEL_INTCONA 0x08
+#define MCP_MODEL_IOCON 0x0A
+#define MCP_MODEL_INTFA 0x0E
+#define MCP_MODEL_INTCAPA 0x10
+#define MCP_MODEL_GPIOA 0x12
+
+class McpModel : public HostWireDevice
+{
+public:
+  /// @brief Model at address with its interrupt output on intPin (NOT_USED: not connected)
+  McpModel(uint8_t address, uint8_t intPin) : _address(address), _intPin(intPin)
+  {
+    _models.push_back(this);
+    Wire.hostAttach(this);
+    _updateInt();
+  }
+  ~McpModel()
+  {
+    _models.erase(std::find(_models.begin(), _models.end(), this));
+  }
+
+  /// @brief Engage inputs, bit n for GPA0..GPB7, engaged inputs are connected to GND
+  void set(uint16_t engaged)
+  {
+    uint16_t level = ~engaged;
+    uint16_t changed = (level ^ _level) & _reg16(MCP_MODEL_GPINTENA);
+    if (changed && _reg16(MCP_MODEL_INTFA) == 0)
+    {
+      _write16(MCP_MODEL_INTCAPA, _read16Port(level));
+    }
+    _write16(MCP_MODEL_INTFA, _reg16(MCP_MODEL_INTFA) | changed);
+    _level = level;
+    _updateInt();
+  }
+
+  /// @brief Register content
+  uint8_t reg(uint8_t address) { return _regs[address]; }
+
+  uint8_t address() { return _address; }
+
+  // first byte sets the register address, following bytes are written sequentially
+  void received(const uint8_t *data, size_t length)
+  {
+    if (length == 0)
+    {
+      return;
+    }
+    _pointer = data[0] % sizeof(_regs);
+    for (size_t i = 1; i < length; i++)
+    {
+      if (_pointer != MCP_MODEL_INTFA && _pointer != MCP_MODEL_INTFA + 1 && _pointer < MCP_MODEL_INTCAPA)
+      {
+        _regs[_pointer] = data[i];
+      }
+      _pointer = (_pointer + 1) % sizeof(_regs);
+    }
+  }
+
+  size_t requested(uint8_t *data, size_t length)
+  {
+    for (size_t i = 0; i < length; i++)
+    {
+      uint8_t pointer = _pointer;
+      if (pointer == MCP_MODEL_GPIOA || pointer == MCP_MODEL_GPIOA + 1)
+      {
+        _regs[pointer] = (uint8_t)(_read16Port(_level) >> ((pointer & 1) * 8));
+      }
+      data[i] = _regs[pointer];
+      // reading GPIO or INTCAP clears the interrupt
+      if (pointer >= MCP_MODEL_INTCAPA && pointer <= MCP_MODEL_GPIOA + 1)
+      {
+        _write16(MCP_MODEL_INTFA, 0);
+      }
+      _pointer = (_pointer + 1) % sizeof(_regs);
+    }
+    _updateInt();
+    return length;
+  }
+
+private:
+  uint16_t _reg16(uint8_t address) { return _regs[address] | (_regs[address + 1] << 8); }
+  void _write16(uint8_t address, uint16_t value)
+  {
+    _regs[address] = (uint8_t)value;
+    _regs[address + 1] = (uint8_t)(value >> 8);
+  }
+  uint16_t _read16Port(uint16_t level) { return level ^ _reg16(0x02); } // IPOL
+
+  // INT is active low, the open drain lines of all models on a pin are wired together
+  void _updateInt()
+  {
+    if (_intPin == NOT_USED)
+    {
+      return;
+    }
+    bool level = true;
+    for (McpModel *model : _models)
+    {
+      if (model->_intPin == _intPin && model->_reg16(MCP_MODEL_INTFA) != 0)
+      {
+        level = false;
+      }
+    }
+    hostSetPin(_intPin, level);
+  }
+
+  uint8_t _address;
+  uint8_t _intPin;
+  uint8_t _regs[0x16] = {0xFF, 0xFF}; // IODIR is all inputs after reset
+  uint8_t _pointer = 0;
+  uint16_t _level = 0xFFFF; // pins float high until engaged
+  static std::vector<McpModel *> _models;
+};
+
+std::vector<McpModel *> McpModel::_models;
+
+#endif
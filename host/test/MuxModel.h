@@ -0,0 +1,54 @@
+/*
+  MuxModel.h - 74HC4067 multiplexers on the pins of the host shim. The model follows the address lines
+  S0-S3 whenever the library samples inputs (digitalRead) or waits for them to settle (delayMicroseconds)
+  and drives each data pin with the selected channel of its mux, low for engaged inputs.
+*/
+#ifndef MuxModel_h
+#define MuxModel_h
+#include <Arduino.h>
+
+class MuxModel
+{
+public:
+  /// @brief Connect the model to the address pins and the data pins of count mux
+  static void attach(const uint8_t *address, const uint8_t *data, int count)
+  {
+    memcpy(_address, address, sizeof(_address));
+    _count = count;
+    for (int m = 0; m < count; m++)
+    {
+      _data[m] = data[m];
+      inputs[m] = 0;
+    }
+    hostInputHook = update;
+    update();
+  }
+
+  /// @brief Engaged inputs per mux, bit n for channel n
+  static uint16_t inputs[16];
+
+  static void update()
+  {
+    int channel = 0;
+    for (int bit = 0; bit < 4; bit++)
+    {
+      channel |= hostGetPin(_address[bit]) << bit;
+    }
+    for (int m = 0; m < _count; m++)
+    {
+      hostSetPin(_data[m], !((inputs[m] >> channel) & 1));
+    }
+  }
+
+private:
+  static uint8_t _address[4];
+  static uint8_t _data[16];
+  static int _count;
+};
+
+uint16_t MuxModel::inputs[16];
+uint8_t MuxModel::_address[4];
+uint8_t MuxModel::_data[16];
+int MuxModel::_count;
+
+#endif
@@ -0,0 +1,585 @@
+/*
+  PluginStandIn.h - Scripted stand-in for the XPLDirect plugin on the other end of a HostStream.
+  Runs the device with xloop() on the virtual clock and models the serial link in both directions
+  (byteMicros per byte, one frame after the other) and the X-Plane flight loop, in which the plugin
+  reads the frames of the device, answers them and polls with XPLCMD_SENDREQUEST.
+  Datarefs and commands get handles in the order they are first registered and keep them when the
+  device reconnects, like the plugin does while X-Plane is running. Switches to binary frames when
+  the device accepts XPL_CAP_BINARY.
+*/
+#ifndef PluginStandIn_h
+#define PluginStandIn_h
+#include <XPLDirect.h>
+
+class PluginStandIn
+{
+public:
+  struct DataRef
+  {
+    std::string name;
+    int rwMode;
+    int index;
+    int count; // > 1 for array blocks
+    float divider;
+    std::vector<std::string> value; // last value received per element, as sent: text or 4 raw bytes
+    unsigned long updates;
+  };
+  struct Command
+  {
+    std::string name;
+    unsigned long starts;
+    unsigned long ends;
+    unsigned long triggers;
+  };
+
+  // settings, change before connect()
+  unsigned long offer = 0;             // capabilities offered after the version, 0 for a legacy plugin
+  unsigned long byteMicros = 87;       // 115200 baud
+  unsigned long flightLoopMicros = 20000;
+  unsigned long loopMicros = 100;      // loop time of the sketch
+  bool answerRegistrations = true;     // false loses the responses to registration requests
+  int handleBase = 0;                  // first handle assigned, > 127 for multi byte varints in binary frames
+
+  // state seen by the plugin
+  std::string name;
+  long version = 0;
+  long capabilities = -1; // accepted by the device, -1 before the answer
+  bool binary = false;    // binary frames in both directions
+  std::vector<DataRef> dataRefs;  // index is the handle - handleBase
+  std::vector<Command> commands;  // index is the handle - handleBase
+  std::vector<std::string> frames; // all frames received from the device, decoded binary frames start with the command
+  std::string statistics;          // payload of the last XPLRESPONSE_STATISTICS
+  unsigned long polls = 0;
+  unsigned long noRequests = 0;
+  unsigned long registrations = 0;
+  unsigned long bytesToDevice = 0;
+  unsigned long bytesFromDevice = 0;
+  double deviceMicros = 0; // real time spent in xloop()
+
+  PluginStandIn(XPLDirect &device, HostStream &link) : _device(device), _link(link) {}
+
+  /// @brief Request the name of the device, as the plugin does when it finds the port. On a binary link
+  /// the request is a binary frame and the capabilities stay as they are.
+  void connect()
+  {
+    if (binary)
+    {
+      send(XPLCMD_SENDNAME, 0, "");
+      return;
+    }
+    _polling = false;
+    capabilities = -1;
+    binary = false;
+    _nextFlightLoop = micros();
+    send("<a>");
+  }
+
+  /// @brief Queue data to the device, it arrives after the data queued before
+  void send(const std::string &data)
+  {
+    bytesToDevice += data.size();
+    _wire(_toDevice, _toDeviceBusy, data);
+  }
+
+  /// @brief Queue a frame with command, handle and payload, as text or binary frame
+  void send(char command, int handle, const std::string &payload)
+  {
+    if (binary)
+    {
+      std::string frame(1, command);
+      for (unsigned int value = handle; frame.size() == 1 || value > 0; value >>= 7)
+      {
+        frame += (char)((value & 0x7F) | (value > 0x7F ? 0x80 : 0));
+      }
+      send(cobsEncode(frame + payload) + std::string(1, '\0'));
+      return;
+    }
+    char tmp[8];
+    snprintf(tmp, sizeof(tmp), "<%c%03d", command, handle);
+    send(tmp + payload + ">");
+  }
+
+  /// @brief Text update with the value as the plugin formats it
+  void update(int handle, const std::string &value)
+  {
+    send(XPLCMD_DATAREFUPDATE, handle, value);
+  }
+
+  void updateInt(int handle, long value)
+  {
+    int32_t raw = value;
+    update(handle, binary ? std::string((const char *)&raw, sizeof(raw)) : std::to_string(value));
+  }
+
+  void updateFloat(int handle, float value)
+  {
+    char tmp[48];
+    snprintf(tmp, sizeof(tmp), "%f", value);
+    update(handle, binary ? std::string((const char *)&value, sizeof(value)) : std::string(tmp));
+  }
+
+  /// @brief Array block update with values from offset on, text frames carry the offset in two digits
+  void updateArray(int handle, int offset, const std::vector<float> &values)
+  {
+    std::string payload;
+    if (binary)
+    {
+      payload += (char)offset;
+      for (float value : values)
+      {
+        payload.append((const char *)&value, sizeof(value));
+      }
+    }
+    else
+    {
+      char tmp[48];
+      snprintf(tmp, sizeof(tmp), "%02d", offset);
+      payload = tmp;
+      for (float value : values)
+      {
+        snprintf(tmp, sizeof(tmp), "%g%c", value, XPLDIRECT_UPDATESEPARATOR);
+        payload += tmp;
+      }
+    }
+    send(XPLCMD_DATAREFUPDATEARRAY, handle, payload);
+  }
+
+  /// @brief Element of the last value received, text is parsed like the plugin does
+  long intValue(int handle, int element = 0)
+  {
+    const std::string &value = dataRef(handle).value[element];
+    if (binary)
+    {
+      int32_t raw = 0;
+      memcpy(&raw, value.data(), min(value.size(), sizeof(raw)));
+      return raw;
+    }
+    return atol(value.c_str());
+  }
+
+  float floatValue(int handle, int element = 0)
+  {
+    const std::string &value = dataRef(handle).value[element];
+    if (binary)
+    {
+      float raw = 0;
+      memcpy(&raw, value.data(), min(value.size(), sizeof(raw)));
+      return raw;
+    }
+    return (float)atof(value.c_str());
+  }
+
+  /// @brief Handle of a registered dataref, -1 if unknown
+  int dataRefHandle(const std::string &dataRefName, int index = 0)
+  {
+    for (size_t h = 0; h < dataRefs.size(); h++)
+    {
+      if (dataRefs[h].name == dataRefName && dataRefs[h].index == index)
+      {
+        return handleBase + (int)h;
+      }
+    }
+    return -1;
+  }
+
+  int commandHandle(const std::string &commandName)
+  {
+    for (size_t h = 0; h < commands.size(); h++)
+    {
+      if (commands[h].name == commandName)
+      {
+        return handleBase + (int)h;
+      }
+    }
+    return -1;
+  }
+
+  DataRef &dataRef(int handle)
+  {
+    return dataRefs.at(handle - handleBase);
+  }
+
+  Command &command(int handle)
+  {
+    return commands.at(handle - handleBase);
+  }
+
+  static std::string cobsEncode(const std::string &data)
+  {
+    std::string encoded(1, 0);
+    size_t codePos = 0;
+    unsigned char code = 1;
+    for (char c : data)
+    {
+      if (c == 0)
+      {
+        encoded[codePos] = code;
+        codePos = encoded.size();
+        encoded += (char)0;
+        code = 1;
+        continue;
+      }
+      encoded += c;
+      if (++code == 0xFF)
+      {
+        encoded[codePos] = code;
+        codePos = encoded.size();
+        encoded += (char)0;
+        code = 1;
+      }
+    }
+    encoded[codePos] = code;
+    return encoded;
+  }
+
+  static bool cobsDecode(const std::string &data, std::string *decoded)
+  {
+    decoded->clear();
+    for (size_t read = 0; read < data.size();)
+    {
+      unsigned char code = data[read++];
+      if (code == 0 || read + code - 1 > data.size())
+      {
+        return false;
+      }
+      decoded->append(data, read, code - 1);
+      read += code - 1;
+      if (code < 0xFF && read < data.size())
+      {
+        *decoded += (char)0;
+      }
+    }
+    return true;
+  }
+
+  /// @brief Run the device and the plugin for us microseconds
+  void run(unsigned long us)
+  {
+    unsigned long start = micros();
+    while (micros() - start < us)
+    {
+      step();
+    }
+  }
+
+  /// @brief Run until done returns true, at most timeout microseconds. Returns the result of done.
+  bool runUntil(std::function<bool()> done, unsigned long timeout)
+  {
+    unsigned long start = micros();
+    while (!done() && micros() - start < timeout)
+    {
+      step();
+    }
+    return done();
+  }
+
+  /// @brief One loop of the sketch
+  void step()
+  {
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    _device.xloop();
+    deviceMicros += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    size_t length;
+    const char *sent = _link.take(&length);
+    if (length > 0)
+    {
+      bytesFromDevice += length;
+      _wire(_toPlugin, _toPluginBusy, std::string(sent, length));
+    }
+    unsigned long now = micros();
+    while (!_toDevice.empty() && (long)(now - _toDevice.front().time) >= 0)
+    {
+      _link.inject(_toDevice.front().data.data(), _toDevice.front().data.size());
+      _toDevice.erase(_toDevice.begin());
+    }
+    while (!_toPlugin.empty() && (long)(now - _toPlugin.front().time) >= 0)
+    {
+      _rxData += _toPlugin.front().data;
+      _toPlugin.erase(_toPlugin.begin());
+    }
+    if ((long)(now - _nextFlightLoop) >= 0)
+    {
+      _nextFlightLoop = now + flightLoopMicros;
+      _flightLoop();
+    }
+    hostAdvanceMicros(loopMicros);
+  }
+
+private:
+  struct _chunk
+  {
+    unsigned long time; // arrival of the last byte
+    std::string data;
+  };
+  XPLDirect &_device;
+  HostStream &_link;
+  std::vector<_chunk> _toDevice;
+  std::vector<_chunk> _toPlugin;
+  unsigned long _toDeviceBusy = 0;
+  unsigned long _toPluginBusy = 0;
+  unsigned long _nextFlightLoop = 0;
+  bool _polling = false;
+  std::string _rxData;
+
+  void _wire(std::vector<_chunk> &queue, unsigned long &busy, const std::string &data)
+  {
+    unsigned long now = micros();
+    if ((long)(busy - now) < 0)
+    {
+      busy = now;
+    }
+    busy += data.size() * byteMicros;
+    queue.push_back({busy, data});
+  }
+
+  void _flightLoop()
+  {
+    while (binary ? _receiveBinary() : _receiveText())
+    {
+    }
+    if (_polling)
+    {
+      polls++;
+      if (binary)
+      {
+        send(XPLCMD_SENDREQUEST, 0, "");
+      }
+      else
+      {
+        send("<f>");
+      }
+    }
+  }
+
+  bool _receiveText()
+  {
+    size_t start = _rxData.find('<');
+    size_t end = _rxData.find('>', start);
+    if (start == std::string::npos || end == std::string::npos)
+    {
+      return false;
+    }
+    std::string frame = _rxData.substr(start, end - start + 1);
+    _rxData.erase(0, end + 1);
+    frames.push_back(frame);
+    _receive(frame[1], frame.substr(2, frame.size() - 3));
+    return true;
+  }
+
+  bool _receiveBinary()
+  {
+    size_t end = _rxData.find('\0');
+    if (end == std::string::npos)
+    {
+      return false;
+    }
+    std::string frame;
+    bool valid = cobsDecode(_rxData.substr(0, end), &frame);
+    _rxData.erase(0, end + 1);
+    if (!valid || frame.size() < 2)
+    { // padding or broken
+      return true;
+    }
+    frames.push_back(frame);
+    size_t pos = 1;
+    int handle = _varint(frame, &pos);
+    _receiveBinary(frame[0], handle, frame.substr(pos));
+    return true;
+  }
+
+  static int _varint(const std::string &data, size_t *pos)
+  {
+    int value = 0;
+    for (int shift = 0; *pos < data.size(); shift += 7)
+    {
+      unsigned char c = data[(*pos)++];
+      value |= (c & 0x7F) << shift;
+      if (!(c & 0x80))
+      {
+        break;
+      }
+    }
+    return value;
+  }
+
+  static long _int32(const std::string &data, size_t pos = 0)
+  {
+    int32_t raw = 0;
+    if (pos < data.size())
+    {
+      memcpy(&raw, data.data() + pos, min(data.size() - pos, sizeof(raw)));
+    }
+    return raw;
+  }
+
+  static float _float(const std::string &data, size_t pos)
+  {
+    float raw = 0;
+    if (pos < data.size())
+    {
+      memcpy(&raw, data.data() + pos, min(data.size() - pos, sizeof(raw)));
+    }
+    return raw;
+  }
+
+  void _receiveBinary(char command, int handle, const std::string &payload)
+  {
+    switch (command)
+    {
+    case XPLRESPONSE_NAME:
+      name = payload;
+      break;
+    case XPLRESPONSE_VERSION:
+      version = _int32(payload);
+      break;
+    case XPLREQUEST_REGISTERDATAREF: // rw, index, divider, name
+      _registerDataRef(payload[0], payload[1], 1, _float(payload, 2), payload.substr(6));
+      break;
+    case XPLREQUEST_REGISTERARRAY: // rw, index, count, divider, name
+      _registerDataRef(payload[0], payload[1], payload[2], _float(payload, 3), payload.substr(7));
+      break;
+    case XPLREQUEST_REGISTERCOMMAND:
+      _registerCommand(payload);
+      break;
+    case XPLREQUEST_NOREQUESTS:
+      noRequests++;
+      break;
+    case XPLCMD_DATAREFUPDATE:
+      _setValue(handle, payload.substr(0, 4));
+      break;
+    case XPLCMD_DATAREFUPDATEMULTI:
+      for (size_t pos = 0; pos < payload.size();)
+      {
+        int h = _varint(payload, &pos);
+        _setValue(h, payload.substr(pos, 4));
+        pos += 4;
+      }
+      break;
+    case XPLCMD_COMMANDSTART:
+    case XPLCMD_COMMANDEND:
+    case XPLCMD_COMMANDTRIGGER:
+      _command(command, handle, _int32(payload));
+      break;
+    case XPLRESPONSE_STATISTICS:
+      statistics = payload;
+      break;
+    default:
+      break;
+    }
+  }
+
+  void _receive(char command, const std::string &payload)
+  {
+    switch (command)
+    {
+    case XPLRESPONSE_NAME:
+      name = payload;
+      send("<v>");
+      break;
+    case XPLRESPONSE_VERSION:
+      version = atol(payload.c_str() + 3);
+      if (offer != 0)
+      {
+        send("<C000" + std::to_string(offer) + ">");
+      }
+      else
+      {
+        _polling = true;
+      }
+      break;
+    case XPLCMD_CAPABILITIES:
+      capabilities = atol(payload.c_str() + 3);
+      binary = (capabilities & XPL_CAP_BINARY) != 0; // the next frame is binary already
+      _polling = true;
+      break;
+    case XPLREQUEST_REGISTERDATAREF: // rw, index, divider, name
+      _registerDataRef(payload[0] - '0', atoi(payload.substr(1, 2).c_str()), 1,
+                       (float)atof(payload.substr(3, 8).c_str()), payload.substr(11));
+      break;
+    case XPLREQUEST_REGISTERARRAY: // rw, index, count, divider, name
+      _registerDataRef(payload[0] - '0', atoi(payload.substr(1, 2).c_str()), atoi(payload.substr(3, 2).c_str()),
+                       (float)atof(payload.substr(5, 8).c_str()), payload.substr(13));
+      break;
+    case XPLREQUEST_REGISTERCOMMAND:
+      _registerCommand(payload);
+      break;
+    case XPLREQUEST_NOREQUESTS:
+      noRequests++;
+      break;
+    case XPLCMD_DATAREFUPDATE:
+      _setValue(atoi(payload.substr(0, 3).c_str()), payload.substr(3));
+      break;
+    case XPLCMD_DATAREFUPDATEMULTI:
+      for (size_t pos = 0, next; (next = payload.find(XPLDIRECT_UPDATESEPARATOR, pos)) != std::string::npos; pos = next + 1)
+      {
+        _setValue(atoi(payload.substr(pos, 3).c_str()), payload.substr(pos + 3, next - pos - 3));
+      }
+      break;
+    case XPLCMD_COMMANDSTART:
+    case XPLCMD_COMMANDEND:
+    case XPLCMD_COMMANDTRIGGER:
+      _command(command, atoi(payload.substr(0, 3).c_str()), atol(payload.c_str() + 3));
+      break;
+    case XPLRESPONSE_STATISTICS:
+      statistics = payload;
+      break;
+    default:
+      break;
+    }
+  }
+
+  void _registerDataRef(int rwMode, int index, int count, float divider, const std::string &dataRefName)
+  {
+    registrations++;
+    int h = dataRefHandle(dataRefName, index);
+    if (h < 0)
+    {
+      h = handleBase + dataRefs.size();
+      dataRefs.push_back({dataRefName, rwMode, index, count, divider, std::vector<std::string>(count), 0});
+    }
+    if (answerRegistrations)
+    {
+      send(XPLRESPONSE_DATAREF, h, dataRefName);
+    }
+  }
+
+  void _registerCommand(const std::string &commandName)
+  {
+    registrations++;
+    int h = commandHandle(commandName);
+    if (h < 0)
+    {
+      h = handleBase + commands.size();
+      commands.push_back({commandName, 0, 0, 0});
+    }
+    if (answerRegistrations)
+    {
+      send(XPLRESPONSE_COMMAND, h, commandName);
+    }
+  }
+
+  void _setValue(int handle, const std::string &value)
+  {
+    if (handle >= handleBase && handle - handleBase < (int)dataRefs.size())
+    {
+      dataRef(handle).value[0] = value;
+      dataRef(handle).updates++;
+    }
+  }
+
+  void _command(char command, int handle, long triggers)
+  {
+    if (handle >= handleBase && handle - handleBase < (int)commands.size())
+    {
+      Command &c = commands[handle - handleBase];
+      if (command == XPLCMD_COMMANDSTART)
+        c.starts++;
+      else if (command == XPLCMD_COMMANDEND)
+        c.ends++;
+      else
+        c.triggers += triggers;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,143 @@
+// Array blocks against the plugin stand-in: one registration and one frame for a range of elements, partial
+// updates from an offset, and frames with offsets outside the block dropped without touching other datarefs.
+// Blocks are limited to elements 0..99, the 2 digit index of the text registration.
+#include <XPLDevices.h>
+#include "HostTest.h"
+#include "PluginStandIn.h"
+
+#define ENGINES 8
+
+static HostStream link;
+static float before[3];
+static float n1[ENGINES];
+static float after;
+
+static bool registered()
+{
+  return XP.allDataRefsRegistered() != 0;
+}
+
+static void unchanged(const float *values, int count, float expected)
+{
+  for (int i = 0; i < count; i++)
+  {
+    CHECK(values[i] == expected);
+  }
+}
+
+static void test(unsigned long offer)
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Array", &link);
+  for (int i = 0; i < 3; i++)
+  {
+    XP.registerDataRef(F("sim/test/before"), XPL_READ, 100, 0, &before[i], i);
+    before[i] = -1;
+  }
+  int block = XP.registerDataRef(F("sim/test/N1"), XPL_READ, 100, 0, n1, 0, ENGINES);
+  CHECK(block >= 0);
+  XP.registerDataRef(F("sim/test/after"), XPL_READ, 100, 0, &after);
+  after = -1;
+
+  PluginStandIn plugin(XP, link);
+  plugin.offer = offer;
+  plugin.connect();
+  CHECK(plugin.runUntil(registered, 2000000));
+  int handle = plugin.dataRefHandle("sim/test/N1");
+  CHECK(handle >= 0);
+  if (handle < 0)
+  {
+    return;
+  }
+  CHECK_EQUAL(ENGINES, plugin.dataRef(handle).count);
+  CHECK_EQUAL(5, plugin.dataRefs.size());
+
+  // all elements in one frame, then a part from an offset
+  plugin.updateArray(handle, 0, {10, 11, 12, 13, 14, 15, 16, 17});
+  plugin.run(50000);
+  for (int e = 0; e < ENGINES; e++)
+  {
+    CHECK(n1[e] == 10 + e);
+  }
+  plugin.updateArray(handle, 5, {25, 26, 27});
+  plugin.run(50000);
+  CHECK(n1[4] == 14 && n1[5] == 25 && n1[7] == 27);
+
+  // more values than elements left, the rest is ignored
+  plugin.updateArray(handle, 6, {36, 37, 38, 39});
+  plugin.run(50000);
+  CHECK(n1[6] == 36 && n1[7] == 37);
+  unchanged(&after, 1, -1);
+  CHECK_EQUAL(0, XP.rxDroppedFrames());
+
+  // offsets outside the block
+  plugin.updateArray(handle, ENGINES, {48});
+  plugin.updateArray(handle, 99, {99});
+  plugin.updateArray(handle, 255, {55});
+  int dropped = 3;
+  if (!plugin.binary)
+  { // not two digits, a '-' used to give offset -3 and write to the dataref 3 entries before the block
+    plugin.send(XPLCMD_DATAREFUPDATEARRAY, handle, "0-5.5;");
+    plugin.send(XPLCMD_DATAREFUPDATEARRAY, handle, "-15.5;");
+    plugin.send(XPLCMD_DATAREFUPDATEARRAY, handle, "a05.5;");
+    plugin.send(XPLCMD_DATAREFUPDATEARRAY, handle, "1");
+    plugin.send(XPLCMD_DATAREFUPDATEARRAY, handle, "");
+    dropped += 5;
+  }
+  else
+  {
+    plugin.send(XPLCMD_DATAREFUPDATEARRAY, handle, "");
+    dropped++;
+  }
+  plugin.run(100000);
+  CHECK_EQUAL(dropped, XP.rxDroppedFrames());
+  unchanged(before, 3, -1);
+  unchanged(&after, 1, -1);
+  CHECK(n1[0] == 10 && n1[5] == 25 && n1[7] == 37);
+}
+
+static void testRange()
+{
+  static float values[8];
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Array", &link);
+  CHECK_EQUAL(-1, XP.registerDataRef(F("sim/test/range"), XPL_READ, 100, 0, values, 99, 2));
+  CHECK_EQUAL(-1, XP.registerDataRef(F("sim/test/range"), XPL_READ, 100, 0, values, 100, 1));
+
+  // the last elements register with their index, in one block and element by element
+  const unsigned long offers[] = {XPL_CAP_PIPELINE | XPL_CAP_ARRAYBLOCK, XPL_CAP_PIPELINE};
+  for (unsigned long offer : offers)
+  {
+    link.clear();
+    XP.begin("Array", &link);
+    CHECK_EQUAL(0, XP.registerDataRef(F("sim/test/range"), XPL_READ, 100, 0, values, 92, 8));
+    PluginStandIn plugin(XP, link);
+    plugin.offer = offer;
+    plugin.connect();
+    CHECK(plugin.runUntil(registered, 2000000));
+    CHECK(plugin.dataRefHandle("sim/test/range", 92) >= 0);
+    if (offer & XPL_CAP_ARRAYBLOCK)
+    {
+      CHECK_EQUAL(1, plugin.dataRefs.size());
+    }
+    else
+    {
+      CHECK(plugin.dataRefHandle("sim/test/range", 99) >= 0);
+      CHECK_EQUAL(8, plugin.dataRefs.size());
+    }
+  }
+}
+
+int main()
+{
+  testRange();
+  test(XPL_CAP_PIPELINE | XPL_CAP_ARRAYBLOCK);
+#if XPLDIRECT_BINARY_PROTOCOL
+  test(XPL_CAP_PIPELINE | XPL_CAP_ARRAYBLOCK | XPL_CAP_BINARY);
+#endif
+  return hostTestResult();
+}
@@ -0,0 +1,134 @@
+// Background mux scan with a simulated timer: tick() is called every TICK_US of virtual time while interrupts
+// are enabled, like from a timer interrupt. handle() takes over complete scans only and leaves the interrupt
+// flag as it found it.
+#include <XPLDevices.h>
+#include "HostTest.h"
+#include "MuxModel.h"
+
+#define TICK_US 100
+
+static const uint8_t address[4] = {22, 23, 24, 25};
+static const uint8_t data[3] = {38, 39, 50};
+static DigitalIn_ *mux;
+static unsigned long ticks;
+
+// virtual time passes with a timer interrupt every TICK_US, held back while interrupts are disabled
+static void run(unsigned long us)
+{
+  for (unsigned long end = micros() + us; micros() < end;)
+  {
+    hostAdvanceMicros(TICK_US);
+    if (SREG & 0x80)
+    {
+      MuxModel::update(); // the address set by the previous tick has settled
+      mux->tick();
+      ticks++;
+    }
+  }
+}
+
+static bool image(uint16_t expected0, uint16_t expected1, uint16_t expected2)
+{
+  const uint16_t expected[3] = {expected0, expected1, expected2};
+  for (int m = 0; m < 3; m++)
+  {
+    for (int channel = 0; channel < 16; channel++)
+    {
+      if (mux->getBit(m, channel) != (bool)((expected[m] >> channel) & 1))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void testSnapshots()
+{
+  hostReset();
+  DigitalIn_ instance;
+  mux = &instance;
+  mux->setMux(address[0], address[1], address[2], address[3]);
+  for (int m = 0; m < 3; m++)
+  {
+    mux->addMux(data[m]);
+  }
+  MuxModel::attach(address, data, 3);
+  mux->setBackgroundScan(true);
+
+  MuxModel::inputs[0] = 0x1234;
+  MuxModel::inputs[1] = 0xFFFF;
+  MuxModel::inputs[2] = 0x8001;
+  run(16 * TICK_US);
+  mux->handle();
+  CHECK(image(0x1234, 0xFFFF, 0x8001));
+
+  // half a scan later the last complete scan is still in place
+  MuxModel::inputs[0] = 0x4321;
+  MuxModel::inputs[1] = 0x0000;
+  run(8 * TICK_US);
+  mux->handle();
+  CHECK(image(0x1234, 0xFFFF, 0x8001));
+  CHECK(!mux->anyChanges());
+  run(8 * TICK_US);
+  mux->handle();
+  CHECK(image(0x4321, 0x0000, 0x8001));
+  CHECK_EQUAL(0x1234 ^ 0x4321, (uint16_t)mux->getChanges(0));
+
+  // a slow loop does not slow down sampling, a change is seen in the next loop
+  ticks = 0;
+  for (int loop = 0; loop < 10; loop++)
+  {
+    MuxModel::inputs[2] = loop;
+    run(20000); // xloop() busy for 20 ms
+    mux->handle();
+    CHECK(image(0x4321, 0x0000, loop));
+  }
+  CHECK_EQUAL(10 * 20000 / TICK_US, ticks);
+
+  // no ticks while interrupts are disabled
+  noInterrupts();
+  MuxModel::inputs[2] = 0xAAAA;
+  run(10 * 16 * TICK_US);
+  interrupts();
+  mux->handle();
+  CHECK(image(0x4321, 0x0000, 9));
+
+  // back to scanning in handle()
+  mux->setBackgroundScan(false);
+  mux->handle();
+  CHECK(image(0x4321, 0x0000, 0xAAAA));
+}
+
+#ifdef ARDUINO_ARCH_AVR
+static void testInterruptFlag()
+{
+  hostReset();
+  DigitalIn_ instance;
+  mux = &instance;
+  mux->setMux(address[0], address[1], address[2], address[3]);
+  mux->addMux(data[0]);
+  MuxModel::attach(address, data, 1);
+
+  // called with interrupts disabled, e.g. from another interrupt, they stay disabled
+  noInterrupts();
+  mux->setBackgroundScan(true);
+  CHECK_EQUAL(0, SREG & 0x80);
+  mux->handle();
+  CHECK_EQUAL(0, SREG & 0x80);
+  interrupts();
+  mux->handle();
+  CHECK_EQUAL(0x80, SREG & 0x80);
+  mux->setBackgroundScan(false);
+  CHECK_EQUAL(0x80, SREG & 0x80);
+}
+#endif
+
+int main()
+{
+  testSnapshots();
+#ifdef ARDUINO_ARCH_AVR
+  testInterruptFlag();
+#endif
+  return hostTestResult();
+}
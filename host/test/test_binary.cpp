@@ -0,0 +1,283 @@
+// Round trips through the plugin stand-in in text and binary framing: values of both directions, commands,
+// one and two byte handle varints and payloads containing 0x00, which COBS has to carry. Pauses within frames,
+// updates of one xloop() packed into multi update frames up to XPLMAX_PACKETSIZE.
+#include <XPLDevices.h>
+#include "HostTest.h"
+#include "PluginStandIn.h"
+
+#define MODE_OFFER_ALL (XPL_CAP_PIPELINE | XPL_CAP_MULTIUPDATE | XPL_CAP_BINARY)
+
+static HostStream link;
+static long readInt;
+static float readFloat;
+static char readString[64];
+static long writeInt;
+static float writeFloat;
+static int command;
+
+// text frames carry at most 10 characters of an integer
+static const long ints[] = {0, 1, -1, 255, 256, 65536, -65536, 2147483647L, -999999999L};
+static const float floats[] = {0.0f, -0.25f, 1e-7f, 3.14159265f, 123456.789f, -1e-3f, 1e9f};
+
+static void setup(PluginStandIn &plugin, unsigned long offer, int handleBase)
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  readInt = writeInt = 0;
+  readFloat = writeFloat = 0;
+  XP.begin("Binary", &link);
+  XP.registerDataRef(F("sim/test/int"), XPL_READ, 100, 1, &readInt);
+  XP.registerDataRef(F("sim/test/float"), XPL_READ, 100, 1, &readFloat);
+  XP.registerDataRef(F("sim/test/string"), XPL_READ, 100, readString);
+  XP.registerDataRef(F("sim/test/writeInt"), XPL_WRITE, 0, 1, &writeInt);
+  XP.registerDataRef(F("sim/test/writeFloat"), XPL_WRITE, 0, 0, &writeFloat);
+  command = XP.registerCommand(F("sim/test/command"));
+  plugin.offer = offer;
+  plugin.handleBase = handleBase;
+  plugin.connect();
+  CHECK(plugin.runUntil([]()
+                        { return XP.allDataRefsRegistered() != 0; },
+                        5000000));
+  CHECK_EQUAL((offer & XPL_CAP_BINARY) != 0, plugin.binary);
+}
+
+static bool closeTo(float expected, float actual, bool exact)
+{
+  if (exact)
+  {
+    return memcmp(&expected, &actual, sizeof(float)) == 0;
+  }
+  return fabs(expected - actual) <= 1e-6 + 1e-6 * fabs(expected); // text has 6 decimals
+}
+
+static void testRoundTrip(unsigned long offer, int handleBase)
+{
+  PluginStandIn plugin(XP, link);
+  setup(plugin, offer, handleBase);
+  bool exact = plugin.binary;
+
+  // plugin to device
+  int h = plugin.dataRefHandle("sim/test/int");
+  for (long value : ints)
+  {
+    plugin.updateInt(h, value);
+    plugin.run(50000);
+    CHECK_EQUAL(value, readInt);
+  }
+  h = plugin.dataRefHandle("sim/test/float");
+  for (float value : floats)
+  {
+    plugin.updateFloat(h, value);
+    plugin.run(50000);
+    CHECK(closeTo(value, readFloat, exact || value == 0));
+  }
+  plugin.update(plugin.dataRefHandle("sim/test/string"), "hello world");
+  plugin.run(50000);
+  CHECK_STRING("hello world", readString);
+
+  // device to plugin
+  h = plugin.dataRefHandle("sim/test/writeInt");
+  for (long value : ints)
+  {
+    writeInt = value;
+    plugin.run(50000);
+    CHECK_EQUAL(value, plugin.intValue(h));
+  }
+  h = plugin.dataRefHandle("sim/test/writeFloat");
+  for (float value : floats)
+  {
+    writeFloat = value;
+    plugin.run(50000);
+    CHECK(closeTo(value, plugin.floatValue(h), exact || value == 0));
+  }
+
+  // commands
+  XP.commandStart(command);
+  XP.commandEnd(command);
+  XP.commandTrigger(command, 3);
+  plugin.run(50000);
+  PluginStandIn::Command &c = plugin.command(plugin.commandHandle("sim/test/command"));
+  CHECK_EQUAL(1, c.starts);
+  CHECK_EQUAL(1, c.ends);
+  CHECK_EQUAL(3, c.triggers);
+
+  CHECK_EQUAL(0, XP.rxMalformedFrames());
+  CHECK_EQUAL(0, XP.rxDroppedFrames());
+}
+
+static void testBinaryPayloads()
+{
+  PluginStandIn plugin(XP, link);
+  setup(plugin, MODE_OFFER_ALL, 200);
+  int h = plugin.dataRefHandle("sim/test/string");
+  uint32_t seed = 7;
+  for (int run = 0; run < 200; run++)
+  {
+    std::string value;
+    int length = 1 + run % 40;
+    for (int i = 0; i < length; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      value += (char)(run % 2 ? (seed >> 16) & 0xFF : 0); // every other run all zero
+    }
+    plugin.update(h, value);
+    plugin.run(20000);
+    CHECK(memcmp(value.data(), readString, length) == 0);
+  }
+
+  plugin.updateInt(plugin.dataRefHandle("sim/test/int"), -2147483647L - 1);
+  plugin.run(50000);
+  CHECK_EQUAL(-2147483647L - 1, readInt);
+
+  // broken COBS code and too short frames are dropped, the next frame is fine
+  unsigned int malformed = XP.rxMalformedFrames();
+  plugin.send(std::string("\x05\x65\0", 3));
+  plugin.send(std::string("\x02\x65\0", 3));
+  plugin.updateInt(plugin.dataRefHandle("sim/test/int"), 4711);
+  plugin.run(50000);
+  CHECK_EQUAL(malformed + 2, XP.rxMalformedFrames());
+  CHECK_EQUAL(4711, readInt);
+
+  // three byte varint beyond the handles an int holds on AVR
+  plugin.send(PluginStandIn::cobsEncode(std::string("e\xFF\xFF\x7F\x01\0\0\0", 8)) + std::string(1, '\0'));
+  plugin.run(50000);
+  CHECK_EQUAL(malformed + 3, XP.rxMalformedFrames());
+  CHECK_EQUAL(4711, readInt);
+}
+
+// a pause in the middle of a binary frame drops the frame but keeps binary mode, a restarted plugin asking for
+// the name in text gets the text protocol
+static void testPauses()
+{
+  PluginStandIn plugin(XP, link);
+  setup(plugin, MODE_OFFER_ALL, 0);
+  int h = plugin.dataRefHandle("sim/test/int");
+  int32_t raw = 1234;
+  std::string frame = PluginStandIn::cobsEncode(std::string("e") + (char)h + std::string((const char *)&raw, 4));
+  unsigned int malformed = XP.rxMalformedFrames();
+  link.inject(frame.data(), 3);
+  for (int ms = 0; ms <= XPLDIRECT_RX_TIMEOUT + 10; ms++)
+  { // the plugin stalls, no polls
+    XP.xloop();
+    hostAdvanceMillis(1);
+  }
+  CHECK_EQUAL(malformed + 1, XP.rxMalformedFrames());
+  plugin.send(frame.substr(3) + std::string(1, '\0'));
+  plugin.updateInt(h, 4242);
+  plugin.run(50000);
+  CHECK_EQUAL(4242, readInt);
+  XP.sendDebugMessage("still binary");
+  plugin.run(50000);
+  CHECK(std::find(plugin.frames.begin(), plugin.frames.end(), std::string("1\0still binary", 14)) != plugin.frames.end());
+
+  PluginStandIn restarted(XP, link);
+  restarted.connect();
+  CHECK(restarted.runUntil([&]()
+                           { return !restarted.name.empty(); },
+                           2 * XPLDIRECT_RX_TIMEOUT * 1000UL));
+  CHECK(restarted.runUntil([]()
+                           { return XP.allDataRefsRegistered() != 0; },
+                           5000000));
+  CHECK(!restarted.binary);
+  restarted.updateInt(restarted.dataRefHandle("sim/test/int"), 5678);
+  restarted.run(50000);
+  CHECK_EQUAL(5678, readInt);
+}
+
+// bytes of _sendBuffer used by a received multi update frame
+static int multiUsed(const std::string &frame, bool binary)
+{
+  return binary ? (int)frame.size() + 1 : (int)frame.size() - 1;
+}
+
+// datarefs changed in one xloop() go out in as few 'M' frames as fit into XPLMAX_PACKETSIZE
+static void testMultiUpdate(unsigned long offer)
+{
+  static char names[20][24];
+  static long values[20];
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Multi", &link);
+  for (int i = 0; i < 20; i++)
+  {
+    snprintf(names[i], sizeof(names[i]), "sim/test/multi%02d", i);
+    values[i] = 0;
+    XP.registerDataRef((XPString_t *)names[i], XPL_WRITE, 0, 1, &values[i]);
+  }
+  PluginStandIn plugin(XP, link);
+  plugin.offer = offer;
+  plugin.connect();
+  CHECK(plugin.runUntil([]()
+                        { return XP.allDataRefsRegistered() != 0; },
+                        5000000));
+  plugin.run(50000);
+  bool binary = plugin.binary;
+  int limit = binary ? XPLMAX_PACKETSIZE - 3 : XPLMAX_PACKETSIZE - 2;
+  int entry = binary ? 2 + 4 : 3 + 4 + 1; // handle, value of 4 digits or bytes, separator in text
+
+  const int changes[] = {3, 20};
+  for (int changed : changes)
+  {
+    for (int i = 0; i < changed; i++)
+    {
+      values[i] = 1000 + changed + i;
+    }
+    size_t first = plugin.frames.size();
+    unsigned long sent = XP.txFrames(XPL_STAT_UPDATE);
+    hostAdvanceMillis(1); // polled datarefs are due again
+    XP.xloop();
+    sent = XP.txFrames(XPL_STAT_UPDATE) - sent; // all of them in this loop
+    plugin.run(50000);
+    std::vector<std::string> multi;
+    for (size_t f = first; f < plugin.frames.size(); f++)
+    {
+      char command = plugin.frames[f][binary ? 0 : 1];
+      CHECK(command != XPLCMD_DATAREFUPDATE);
+      if (command == XPLCMD_DATAREFUPDATEMULTI)
+      {
+        multi.push_back(plugin.frames[f]);
+      }
+    }
+    if (changed * entry <= limit - 3)
+    {
+      CHECK_EQUAL(1, multi.size());
+    }
+    int entries = 0;
+    for (size_t m = 0; m < multi.size(); m++)
+    {
+      // binary entries are a one byte handle and 4 bytes after command and handle 0
+      entries += binary ? (multi[m].size() - 2) / 5 : std::count(multi[m].begin(), multi[m].end(), XPLDIRECT_UPDATESEPARATOR);
+      int used = multiUsed(multi[m], binary);
+      CHECK(used <= limit);
+      if (m + 1 < multi.size())
+      { // full, the next entry went into the next frame
+        CHECK(used + entry > limit);
+      }
+    }
+    CHECK_EQUAL(sent, multi.size());
+    CHECK(multi.size() > 1 || changed < 20);
+    CHECK_EQUAL(changed, entries);
+    for (int i = 0; i < changed; i++)
+    {
+      CHECK_EQUAL(1000 + changed + i, plugin.intValue(plugin.dataRefHandle(names[i])));
+    }
+  }
+}
+
+int main()
+{
+  const int handleBases[] = {0, 300}; // beyond the handle map and two byte varints
+  for (int handleBase : handleBases)
+  {
+    testRoundTrip(0, handleBase);
+    testRoundTrip(XPL_CAP_PIPELINE | XPL_CAP_MULTIUPDATE, handleBase);
+    testRoundTrip(MODE_OFFER_ALL, handleBase);
+  }
+  testBinaryPayloads();
+  testPauses();
+  testMultiUpdate(XPL_CAP_PIPELINE | XPL_CAP_MULTIUPDATE);
+  testMultiUpdate(MODE_OFFER_ALL);
+  return hostTestResult();
+}
@@ -0,0 +1,121 @@
+// Changed set and callbacks for datarefs updated by xplane: nextChanged() iterates the updates of the last
+// xloop() in dataref order, the set is cleared by the next xloop(), callbacks fire once per update.
+#include <XPLDevices.h>
+#include "HostTest.h"
+
+#define REFS 20
+
+static HostStream link;
+static char names[REFS][24];
+static long values[REFS];
+static long written;
+static int writtenHandle;
+static std::vector<int> called;
+
+static void callback(int handle)
+{
+  called.push_back(handle);
+}
+
+static std::vector<int> changed()
+{
+  std::vector<int> handles;
+  for (int i = XP.nextChanged(-1); i >= 0; i = XP.nextChanged(i))
+  {
+    handles.push_back(i);
+  }
+  return handles;
+}
+
+static void setup()
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Changed", &link);
+  char frame[40];
+  link.inject("<a>");
+  for (int i = 0; i < REFS; i++)
+  {
+    snprintf(names[i], sizeof(names[i]), "sim/test/ref%02d", i);
+    XP.registerDataRef((XPString_t *)names[i], XPL_READ, 100, 1, &values[i]);
+    snprintf(frame, sizeof(frame), "<3%03d%s>", 100 + i, names[i]); // handles differ from the indexes
+    link.inject(frame);
+  }
+  writtenHandle = XP.registerDataRef(F("sim/test/written"), XPL_WRITE, 0, 1, &written);
+  link.inject("<3200sim/test/written><f>");
+  XP.xloop();
+  XP.xloop();
+  link.take();
+  CHECK(XP.allDataRefsRegistered());
+}
+
+static void update(int i, long value)
+{
+  char frame[24];
+  snprintf(frame, sizeof(frame), "<e%03d%ld>", 100 + i, value);
+  link.inject(frame);
+}
+
+static void testOrder()
+{
+  setup();
+  CHECK_EQUAL(-1, XP.nextChanged(-1));
+
+  // received in any order, spread over several bytes of the set, one of them twice
+  const int order[] = {17, 3, 8, 0, 9, 3, 15};
+  for (int i : order)
+  {
+    update(i, 1000 + i);
+  }
+  XP.xloop();
+  std::vector<int> expected = {0, 3, 8, 9, 15, 17};
+  CHECK(changed() == expected);
+  CHECK_EQUAL(1017, values[17]);
+  CHECK_EQUAL(8, XP.nextChanged(3));
+  CHECK_EQUAL(-1, XP.nextChanged(17));
+
+  // the next loop starts with an empty set
+  XP.xloop();
+  CHECK(changed().empty());
+  update(19, 1);
+  XP.xloop();
+  expected = {19};
+  CHECK(changed() == expected);
+  XP.xloop();
+  CHECK(changed().empty());
+}
+
+static void testCallback()
+{
+  setup();
+  CHECK_EQUAL(0, XP.setCallback(5, callback));
+  CHECK_EQUAL(0, XP.setCallback(12, callback));
+  CHECK_EQUAL(-1, XP.setCallback(writtenHandle, callback)); // never updated by xplane
+  CHECK_EQUAL(-1, XP.setCallback(REFS + 1, callback));
+
+  update(12, 7);
+  update(4, 7);
+  update(5, 8);
+  update(12, 9);
+  XP.xloop();
+  std::vector<int> expected = {12, 5, 12}; // in order of arrival, once per update
+  CHECK(called == expected);
+  CHECK_EQUAL(9, values[12]);
+
+  // removed again
+  called.clear();
+  CHECK_EQUAL(0, XP.setCallback(12, NULL));
+  update(12, 10);
+  update(5, 11);
+  XP.xloop();
+  expected = {5};
+  CHECK(called == expected);
+}
+
+int main()
+{
+  testOrder();
+  testCallback();
+  return hostTestResult();
+}
@@ -0,0 +1,135 @@
+// Deadband for written float datarefs: noise of an AnalogIn on a divider step is replayed to two datarefs,
+// with divider only and with divider and deadband, and the frames sent for each are counted. The pot rests
+// on a step boundary, moves to another position and rests there again. Initial values close to the placeholder
+// of the last sent value are sent despite the deadband.
+#include <XPLDevices.h>
+#include "HostTest.h"
+
+#define PIN 14
+#define NOISE 3 // counts, +-
+#define SAMPLES 5000
+
+static HostStream link;
+static AnalogIn pot(PIN, unipolar);
+static float plain;
+static float filtered;
+static int plainFrames;
+static int filteredFrames;
+static float lastFiltered;
+
+static uint32_t seed = 1234;
+static int noise()
+{
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 16) % (2 * NOISE + 1)) - NOISE;
+}
+
+static void count()
+{
+  std::string data = link.take();
+  for (size_t start = 0, end; (start = data.find("<e", start)) != std::string::npos &&
+                              (end = data.find('>', start)) != std::string::npos;
+       start = end + 1)
+  {
+    int handle = atoi(data.substr(start + 2, 3).c_str());
+    if (handle == 0)
+    {
+      plainFrames++;
+    }
+    else
+    {
+      filteredFrames++;
+      lastFiltered = atof(data.substr(start + 5, end - start - 5).c_str());
+    }
+  }
+}
+
+// one sample per millisecond around center
+static void replay(int center, int samples)
+{
+  for (int i = 0; i < samples; i++)
+  {
+    hostSetAnalog(PIN, center + noise());
+    pot.handle();
+    plain = pot.value();
+    filtered = pot.value();
+    XP.xloop();
+    hostAdvanceMillis(1);
+    count();
+  }
+}
+
+static void testInitial()
+{
+  static float indexed = 0.003f;
+  static float single = -0.995f;
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Deadband", &link);
+  XP.setDeadband(XP.registerDataRef(F("sim/test/indexed"), XPL_WRITE, 0, 0, &indexed, 1), 0.01, 0);
+  XP.setDeadband(XP.registerDataRef(F("sim/test/single"), XPL_WRITE, 0, 0, &single), 0.01, 0);
+  link.inject("<a><3000sim/test/indexed><3001sim/test/single><f>");
+  XP.xloop();
+  XP.xloop();
+  CHECK(XP.allDataRefsRegistered());
+  hostAdvanceMillis(1);
+  XP.xloop();
+  std::string data = link.take();
+  CHECK(data.find("<e0000.003>") != std::string::npos);
+  CHECK(data.find("<e001-0.995>") != std::string::npos);
+
+  // the deadband applies from then on
+  indexed = 0.008f;
+  hostAdvanceMillis(1);
+  XP.xloop();
+  CHECK(std::string(link.take()).find("<e000") == std::string::npos);
+}
+
+int main()
+{
+  testInitial();
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Deadband", &link);
+  XP.registerDataRef(F("sim/test/plain"), XPL_WRITE, 0, 0.01, &plain);
+  int handle = XP.registerDataRef(F("sim/test/filtered"), XPL_WRITE, 0, 0.01, &filtered);
+  CHECK_EQUAL(0, XP.setDeadband(handle, 0.004, 0));
+  link.inject("<a><3000sim/test/plain><3001sim/test/filtered><f>");
+  XP.xloop();
+  XP.xloop();
+  CHECK(XP.allDataRefsRegistered());
+  link.clear();
+
+  // raw 511.5 is the step from 0.49 to 0.50
+  hostSetAnalog(PIN, 512);
+  replay(512, SAMPLES);
+  printf("resting on a step, %d samples: %d frames without deadband, %d with, %d suppressed\n", SAMPLES,
+         plainFrames, filteredFrames, plainFrames - filteredFrames);
+  CHECK(plainFrames > SAMPLES / 10);
+  CHECK(filteredFrames <= 2);
+  CHECK(fabs(lastFiltered - 0.5) <= 0.01);
+
+  // the value itself is not quantized
+  hostSetAnalog(PIN, 700);
+  pot.handle();
+  filtered = pot.value();
+  XP.xloop();
+  CHECK(filtered == 700.0f / 1023);
+  link.clear();
+
+  // moves and rests at the new position, the deadband follows
+  plainFrames = filteredFrames = 0;
+  for (int position = 512; position <= 800; position += 4)
+  {
+    replay(position, 10);
+  }
+  replay(800, SAMPLES);
+  printf("moving and resting, %d samples: %d frames without deadband, %d with, %d suppressed\n",
+         SAMPLES + 730, plainFrames, filteredFrames, plainFrames - filteredFrames);
+  CHECK(filteredFrames > 10);
+  CHECK(filteredFrames < plainFrames / 5);
+  CHECK(fabs(lastFiltered - 800.0 / 1023) <= 0.004 + 0.01 + NOISE / 1023.0);
+  return hostTestResult();
+}
@@ -0,0 +1,153 @@
+// Edge driven devices, built with MUX_EVENT_QUEUE: every device class exists twice on the same inputs, one polled
+// every loop, the other handled on DigitalIn events of its inputs and then every loop until idle(). Random input
+// changes with bounces have to give both the same transitions, states and counts in every loop.
+#include <XPLDevices.h>
+#include "HostTest.h"
+#include "MuxModel.h"
+
+#define MUX 2
+#define LOOPS 20000
+
+static const uint8_t address[4] = {22, 23, 24, 25};
+static const uint8_t data[MUX] = {38, 39};
+
+// one device class behind a common interface, sample() consumes the transitions of the loop
+struct Device
+{
+  std::function<void()> handle;
+  std::function<bool()> idle;
+  std::function<long()> sample;
+  uint16_t inputs[MUX]; // channels used per mux
+};
+
+static std::vector<Device> polled;
+static std::vector<Device> edge;
+
+static void add(std::vector<Device> &devices, uint8_t mux, uint8_t channel)
+{
+  Button *button = new Button(mux, channel);
+  devices.push_back({[=]() { button->handle(); }, [=]() { return button->idle(); },
+                     [=]() { return button->pressed() * 1 + button->released() * 2 + button->engaged() * 4; }, {}});
+  devices.back().inputs[mux] = 1 << channel;
+
+  RepeatButton *repeat = new RepeatButton(mux, channel + 1, 50);
+  devices.push_back({[=]() { repeat->handle(); }, [=]() { return repeat->idle(); },
+                     [=]() { return repeat->pressed() * 1 + repeat->released() * 2 + repeat->engaged() * 4; }, {}});
+  devices.back().inputs[mux] = 1 << (channel + 1);
+
+  Switch *sw = new Switch(mux, channel + 2);
+  devices.push_back({[=]() { sw->handle(); }, [=]() { return sw->idle(); },
+                     [=]() { return (long)sw->on(); }, {}});
+  devices.back().inputs[mux] = 1 << (channel + 2);
+
+  Switch2 *sw2 = new Switch2(mux, channel + 3, channel + 4);
+  devices.push_back({[=]() { sw2->handle(); }, [=]() { return sw2->idle(); },
+                     [=]() { return sw2->on1() * 1 + sw2->on2() * 2; }, {}});
+  devices.back().inputs[mux] = 3 << (channel + 3);
+
+  Encoder *encoder = new Encoder(mux, channel + 5, channel + 6, channel + 7, enc4Pulse);
+  devices.push_back({[=]() { encoder->handle(); }, [=]() { return encoder->idle(); },
+                     [=]() { return encoder->pos() * 4 + encoder->pressed() * 1 + encoder->released() * 2; }, {}});
+  devices.back().inputs[mux] = 7 << (channel + 5);
+}
+
+static uint32_t seed = 2024;
+static int random(int range)
+{
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % range);
+}
+
+int main()
+{
+  hostReset();
+  DigitalIn.setMux(address[0], address[1], address[2], address[3]);
+  for (int m = 0; m < MUX; m++)
+  {
+    DigitalIn.addMux(data[m]);
+  }
+  MuxModel::attach(address, data, MUX);
+  const uint8_t first[MUX] = {0, 8};
+  for (int m = 0; m < MUX; m++)
+  {
+    add(polled, m, first[m]);
+    add(edge, m, first[m]);
+  }
+
+  std::vector<bool> active(edge.size(), false);
+  std::vector<int> activeList;
+  unsigned long handled = 0;
+  unsigned long edges = 0;
+  for (int loop = 0; loop < LOOPS; loop++)
+  {
+    // an input changes in one loop out of 20, a third of the changes bounce back in the next loop
+    static int bounce = -1;
+    if (bounce >= 0)
+    {
+      MuxModel::inputs[bounce / 16] ^= 1 << (bounce % 16);
+      bounce = -1;
+    }
+    else if (random(20) == 0)
+    {
+      int m = random(MUX);
+      int input = m * 16 + first[m] + random(8);
+      MuxModel::inputs[m] ^= 1 << (input % 16);
+      bounce = random(3) == 0 ? input : -1;
+    }
+    DigitalIn.handle();
+
+    for (Device &device : polled)
+    {
+      device.handle();
+    }
+
+    DigitalInEvent_t event;
+    while (DigitalIn.nextEvent(&event))
+    {
+      edges++;
+      for (size_t d = 0; d < edge.size(); d++)
+      {
+        if (!active[d] && (edge[d].inputs[event.expander] >> event.channel) & 1)
+        {
+          active[d] = true;
+          activeList.push_back(d);
+        }
+      }
+    }
+    for (size_t a = 0; a < activeList.size();)
+    {
+      int d = activeList[a];
+      edge[d].handle();
+      handled++;
+      if (edge[d].idle())
+      {
+        active[d] = false;
+        activeList[a] = activeList.back();
+        activeList.pop_back();
+      }
+      else
+      {
+        a++;
+      }
+    }
+
+    for (size_t d = 0; d < edge.size(); d++)
+    {
+      long expected = polled[d].sample();
+      long actual = edge[d].sample();
+      if (expected != actual)
+      {
+        printf("loop %d, device %d: polled %ld, edge driven %ld\n", loop, (int)d, expected, actual);
+        CHECK_EQUAL(expected, actual);
+        return hostTestResult();
+      }
+    }
+    hostAdvanceMillis(1);
+  }
+  CHECK_EQUAL(0, DigitalIn.eventsDropped());
+  CHECK(edges > LOOPS / 30);
+  printf("%d loops, %lu edges: %lu handle() calls edge driven, %lu polled\n", LOOPS, edges, handled,
+         (unsigned long)LOOPS * polled.size());
+  CHECK(handled < (unsigned long)LOOPS * polled.size() / 2); // held repeat buttons stay active
+  return hostTestResult();
+}
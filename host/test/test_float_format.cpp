@@ -0,0 +1,239 @@
+// Fixed point float conversions against the libc routines they replace: decimals derived from the divider,
+// outgoing updates against printf() and incoming updates against atof(), with random values of all magnitudes.
+// Outgoing values read back as the same float with the fewest decimals the divider allows, incoming values
+// are the same float as atof() up to 7 significant digits and at most 1 ulp off beyond.
+#include <XPLDevices.h>
+#include "HostTest.h"
+
+static const float dividers[] = {0, 1, 2, 0.5, 0.25, 0.1, 0.01, 0.001, 0.0005, 0.0001, 0.00005, 0.000001};
+static const int decimals[] = {6, 0, 0, 1, 2, 1, 2, 3, 4, 4, 5, 6};
+#define DIVIDERS (int)(sizeof(dividers) / sizeof(dividers[0]))
+
+static HostStream link;
+static float written[DIVIDERS];
+static float received;
+
+static uint32_t seed = 4711;
+static uint32_t random32()
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+// random value with magnitude 1e-7 .. 1e7
+static float randomValue()
+{
+  float mantissa = (random32() % 10000000) / 1e6f;
+  float value = mantissa * powf(10, (int)(random32() % 15) - 7);
+  return random32() % 2 ? -value : value;
+}
+
+static void setup()
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Float", &link);
+  char frame[40];
+  link.inject("<a>");
+  for (int d = 0; d < DIVIDERS; d++)
+  {
+    XP.registerDataRef(F("sim/test/written"), XPL_WRITE, 0, dividers[d], &written[d], d);
+    snprintf(frame, sizeof(frame), "<3%03dsim/test/written>", d);
+    link.inject(frame);
+  }
+  XP.registerDataRef(F("sim/test/received"), XPL_READ, 0, 0, &received);
+  link.inject("<3100sim/test/received>");
+  link.inject("<f>");
+  XP.xloop();
+  XP.xloop();
+  link.take();
+}
+
+// updates of the last loop by handle
+static std::map<int, std::string> updates()
+{
+  std::map<int, std::string> sent;
+  std::string data = link.take();
+  for (size_t start = 0, end; (start = data.find("<e", start)) != std::string::npos &&
+                              (end = data.find('>', start)) != std::string::npos;
+       start = end + 1)
+  {
+    sent[atoi(data.substr(start + 2, 3).c_str())] = data.substr(start + 5, end - start - 5);
+  }
+  return sent;
+}
+
+static void testDecimals()
+{
+  setup();
+  for (int d = 0; d < DIVIDERS; d++)
+  {
+    written[d] = 1.2345678f;
+  }
+  hostAdvanceMillis(1);
+  XP.xloop();
+  std::map<int, std::string> sent = updates();
+  for (int d = 0; d < DIVIDERS; d++)
+  {
+    std::string value = sent[d];
+    size_t point = value.find('.');
+    int digits = point == std::string::npos ? 0 : value.size() - point - 1;
+    if (digits > decimals[d])
+    {
+      printf("divider %g: %s has more than %d decimals\n", dividers[d], value.c_str(), decimals[d]);
+    }
+    CHECK(digits <= decimals[d]);
+    CHECK(fabs(atof(value.c_str()) - 1.2345678) < (dividers[d] > 0 ? dividers[d] : 1e-6));
+  }
+  CHECK_STRING("1.2345", sent[9].c_str()); // 0.0001 was sent without decimals
+  CHECK_STRING("1.23455", sent[10].c_str());
+}
+
+static int decimalsOf(const std::string &value)
+{
+  size_t point = value.find('.');
+  return point == std::string::npos ? 0 : (int)(value.size() - point - 1);
+}
+
+// the value written as the library sends it, against the decimals printf needs to read back the same float
+static void checkFormat(float value, const std::string &sent, int d)
+{
+  float sendValue = dividers[d] > 0 ? (int)(value / dividers[d]) * dividers[d] : value;
+  int shortest = -1;
+  char expected[64];
+  for (int digits = 0; digits <= decimals[d] && shortest < 0; digits++)
+  {
+    snprintf(expected, sizeof(expected), "%.*f", digits, sendValue);
+    if ((float)atof(expected) == sendValue)
+    {
+      shortest = digits;
+    }
+  }
+  bool failed = decimalsOf(sent) > decimals[d];
+  if (shortest >= 0)
+  { // reads back as the same float, with as few decimals as printf when the spacing of floats is known
+    failed |= (float)atof(sent.c_str()) != sendValue;
+    float magnitude = fabsf(sendValue);
+    bool powerOfTwo = magnitude == ldexpf(1, ilogbf(magnitude));
+    failed |= magnitude >= 0.03125 && !powerOfTwo && decimalsOf(sent) != shortest;
+  }
+  else
+  { // correctly rounded to the decimals
+    failed |= fabs(atof(sent.c_str()) - (double)sendValue) > 0.5 * pow(10, -decimals[d]) * (1 + 1e-9);
+  }
+  failed |= sent == "-0";
+  if (failed)
+  {
+    snprintf(expected, sizeof(expected), "%.*f", shortest >= 0 ? shortest : decimals[d], sendValue);
+    printf("%.9g divider %g: sent %s, printf %s\n", value, dividers[d], sent.c_str(), expected);
+  }
+  CHECK(!failed);
+}
+
+static void testFormat()
+{
+  setup();
+  // values without divider formerly cut to 7 significant digits, rounding carries, powers of two, signs
+  const float edges[] = {1234.5677f, 16777.215f, 8388607.5f, 8388608, 4194303.75f, 0.99999994f, 9.9999995f,
+                         0.5f, 0.25f, 0.03125f, 1024, 0.1f, 0.3f, 0.001f, 0.0000005f, -0.0000004f, 1e-7f, 0};
+  int compared = 0;
+  for (float edge : edges)
+  {
+    for (int d = 0; d < DIVIDERS; d++)
+    {
+      for (float value : {edge, -edge})
+      {
+        if (dividers[d] > 0 && fabs(value / dividers[d]) >= 2e9)
+        { // the multiple of the divider overflows int
+          continue;
+        }
+        written[d] = 12345; // always a change
+        hostAdvanceMillis(1);
+        XP.xloop();
+        link.take();
+        written[d] = value;
+        hostAdvanceMillis(1);
+        XP.xloop();
+        std::map<int, std::string> sent = updates();
+        CHECK(sent.find(d) != sent.end());
+        checkFormat(value, sent[d], d);
+        compared++;
+      }
+    }
+  }
+  for (int run = 0; run < 20000; run++)
+  {
+    int d = random32() % DIVIDERS;
+    float value = randomValue();
+    written[d] = value;
+    hostAdvanceMillis(1);
+    XP.xloop();
+    std::map<int, std::string> sent = updates();
+    if (sent.find(d) == sent.end())
+    { // same as the last value sent
+      continue;
+    }
+    compared++;
+    checkFormat(value, sent[d], d);
+  }
+  CHECK(compared > 15000);
+}
+
+static int ulps(float a, float b)
+{
+  int n = 0;
+  while (a != b && n < 100)
+  {
+    a = nextafterf(a, b);
+    n++;
+  }
+  return n;
+}
+
+static void testParse()
+{
+  setup();
+  int worst = 0;
+  for (int run = 0; run < 20000; run++)
+  {
+    char text[48];
+    snprintf(text, sizeof(text), "%.*f", (int)(random32() % 7), randomValue());
+    if (strlen(text) > 10)
+    { // text frames carry 10 characters
+      text[10] = 0;
+    }
+    std::string frame = "<e100" + std::string(text) + ">";
+    link.inject(frame.c_str());
+    XP.xloop();
+    float expected = (float)atof(text);
+    int error = ulps(expected, received);
+    worst = max(worst, error);
+    // exact while the digits fit into the 24 bit mantissa of a float
+    unsigned long mantissa = 0;
+    for (const char *p = text; *p != 0 && mantissa < 0x1000000UL; p++)
+    {
+      if (*p >= '0' && *p <= '9')
+      {
+        mantissa = mantissa * 10 + (*p - '0');
+      }
+    }
+    int allowed = mantissa < 0x1000000UL ? 0 : 1;
+    if (error > allowed)
+    {
+      printf("%s: parsed %.9g, atof %.9g\n", text, received, expected);
+    }
+    CHECK(error <= allowed);
+  }
+  printf("parse: worst %d ulp\n", worst);
+}
+
+int main()
+{
+  testDecimals();
+  testFormat();
+  testParse();
+  return hostTestResult();
+}
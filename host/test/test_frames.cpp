@@ -0,0 +1,124 @@
+// Text frames byte for byte against the sprintf() format strings the frame builder replaced: registrations
+// with all kinds of dividers and indexes, commands, integer updates and messages.
+#include <XPLDevices.h>
+#include "HostTest.h"
+
+#define REFS 12
+#define COMMANDS 3
+
+static const float dividers[REFS] = {1, 0, 2.5, 0.07, -1, -0.5, -0.05, -12.34, 99999.99, 123456, -123456, 0.5};
+static const int modes[REFS] = {XPL_READ, XPL_WRITE, XPL_READWRITE, XPL_WRITE, XPL_WRITE, XPL_WRITE,
+                                XPL_WRITE, XPL_WRITE, XPL_WRITE, XPL_WRITE, XPL_WRITE, XPL_WRITE};
+static const int indexes[REFS] = {0, 1, 5, 0, 12, 99, 0, 3, 0, 0, 0, 7};
+static const long updates[] = {1, 0, -1, 42, -42, 99999, -100000, 2147483647L, -2147483647L - 1};
+
+static HostStream link;
+static char names[REFS][24];
+static char commandNames[COMMANDS][24];
+static long values[REFS];
+static int commands[COMMANDS];
+
+static std::vector<std::string> frames(const char *received)
+{
+  link.inject(received);
+  std::string data;
+  for (int loop = 0; loop < 20; loop++)
+  {
+    XP.xloop();
+    hostAdvanceMillis(1);
+    data += link.take();
+  }
+  std::vector<std::string> sent;
+  for (size_t start = 0, end; (start = data.find('<', start)) != std::string::npos &&
+                              (end = data.find('>', start)) != std::string::npos;
+       start = end + 1)
+  {
+    sent.push_back(data.substr(start, end - start + 1));
+  }
+  return sent;
+}
+
+static void compare(const std::vector<std::string> &sent, const std::vector<std::string> &expected)
+{
+  CHECK_EQUAL(expected.size(), sent.size());
+  for (size_t i = 0; i < expected.size() && i < sent.size(); i++)
+  {
+    CHECK_STRING(expected[i].c_str(), sent[i].c_str());
+  }
+}
+
+int main()
+{
+  hostReset();
+  link.writeSpace = 64;
+  XP.begin("Frames", &link);
+  for (int i = 0; i < REFS; i++)
+  {
+    snprintf(names[i], sizeof(names[i]), "sim/test/ref%02d", i);
+    XP.registerDataRef((XPString_t *)names[i], modes[i], 0, dividers[i], &values[i], indexes[i]);
+  }
+  for (int i = 0; i < COMMANDS; i++)
+  {
+    snprintf(commandNames[i], sizeof(commandNames[i]), "sim/test/command%d", i);
+    commands[i] = XP.registerCommand((XPString_t *)commandNames[i]);
+  }
+  frames("<a>");
+
+  // a legacy plugin gets one registration per poll
+  char buffer[XPLMAX_PACKETSIZE * 2];
+  std::vector<std::string> sent, expected;
+  for (int i = 0; i < REFS; i++)
+  {
+    sprintf(buffer, "%c%c%1.1i%2.2i%05i.%02i%s%c", XPLDIRECT_PACKETHEADER, XPLREQUEST_REGISTERDATAREF, modes[i], indexes[i],
+            (int)dividers[i], (int)(dividers[i] * 100) % 100, names[i], XPLDIRECT_PACKETTRAILER);
+    sent = frames("<f>");
+    sent.resize(min(sent.size(), (size_t)1));
+    compare(sent, {buffer});
+    // handles up to 999, printed with three digits
+    snprintf(buffer, sizeof(buffer), "<3%03d%s>", 988 + i, names[i]);
+    frames(buffer);
+  }
+  for (int i = 0; i < COMMANDS; i++)
+  {
+    sprintf(buffer, "%c%c%s%c", XPLDIRECT_PACKETHEADER, XPLREQUEST_REGISTERCOMMAND, commandNames[i], XPLDIRECT_PACKETTRAILER);
+    sent = frames("<f>");
+    sent.resize(min(sent.size(), (size_t)1));
+    compare(sent, {buffer});
+    snprintf(buffer, sizeof(buffer), "<4%03d%s>", 7 * i, commandNames[i]);
+    frames(buffer);
+  }
+  sprintf(buffer, "%c%c%c", XPLDIRECT_PACKETHEADER, XPLREQUEST_NOREQUESTS, XPLDIRECT_PACKETTRAILER);
+  compare(frames("<f>"), {buffer});
+  CHECK(XP.allDataRefsRegistered());
+
+  // integer updates of a written dataref with divider 1
+  for (long value : updates)
+  {
+    values[1] = value;
+    sprintf(buffer, "%c%c%3.3i%ld%c", XPLDIRECT_PACKETHEADER, XPLCMD_DATAREFUPDATE, 989, value, XPLDIRECT_PACKETTRAILER);
+    compare(frames(""), {buffer});
+  }
+
+  // commands and messages
+  expected.clear();
+  XP.commandTrigger(commands[1]);
+  sprintf(buffer, "%c%c%3.3i%ld%c", XPLDIRECT_PACKETHEADER, XPLCMD_COMMANDTRIGGER, 7, 1L, XPLDIRECT_PACKETTRAILER);
+  expected.push_back(buffer);
+  XP.commandTrigger(commands[2], 12);
+  sprintf(buffer, "%c%c%3.3i%ld%c", XPLDIRECT_PACKETHEADER, XPLCMD_COMMANDTRIGGER, 14, 12L, XPLDIRECT_PACKETTRAILER);
+  expected.push_back(buffer);
+  XP.commandStart(commands[0]);
+  sprintf(buffer, "%c%c%3.3i%c", XPLDIRECT_PACKETHEADER, XPLCMD_COMMANDSTART, 0, XPLDIRECT_PACKETTRAILER);
+  expected.push_back(buffer);
+  XP.commandEnd(commands[0]);
+  sprintf(buffer, "%c%c%3.3i%c", XPLDIRECT_PACKETHEADER, XPLCMD_COMMANDEND, 0, XPLDIRECT_PACKETTRAILER);
+  expected.push_back(buffer);
+  XP.sendDebugMessage("debug 1, 2");
+  sprintf(buffer, "%c%c%s%c", XPLDIRECT_PACKETHEADER, XPLCMD_PRINTDEBUG, "debug 1, 2", XPLDIRECT_PACKETTRAILER);
+  expected.push_back(buffer);
+  XP.sendSpeakMessage("gear down");
+  sprintf(buffer, "%c%c%s%c", XPLDIRECT_PACKETHEADER, XPLCMD_SPEAK, "gear down", XPLDIRECT_PACKETTRAILER);
+  expected.push_back(buffer);
+  compare(frames(""), expected);
+  return hostTestResult();
+}
@@ -0,0 +1,117 @@
+// Smoke test of the host build: the shim behaves like the Arduino core where the library relies on it,
+// and every device class runs on it.
+#include <XPLDevices.h>
+#include "HostTest.h"
+
+static void testShim()
+{
+  hostReset();
+  CHECK_EQUAL(0, millis());
+  hostAdvanceMillis(5);
+  CHECK_EQUAL(5, millis());
+  CHECK_EQUAL(5000, micros());
+  delay(3);
+  delayMicroseconds(500);
+  CHECK_EQUAL(8500, micros());
+
+  pinMode(20, INPUT_PULLUP);
+  CHECK_EQUAL(HIGH, digitalRead(20));
+  hostSetPin(20, LOW);
+  CHECK_EQUAL(LOW, digitalRead(20));
+  CHECK_EQUAL(0, *portInputRegister(digitalPinToPort(20)) & digitalPinToBitMask(20));
+  digitalWrite(21, HIGH);
+  CHECK(hostGetPin(21));
+  CHECK(*portOutputRegister(digitalPinToPort(21)) & digitalPinToBitMask(21));
+  hostSetAnalog(A0, 321);
+  CHECK_EQUAL(321, analogRead(A0));
+
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  CHECK_EQUAL(0, SREG & 0x80);
+  SREG = oldSREG;
+  CHECK_EQUAL(0x80, SREG & 0x80);
+
+  XPString_t *name = F("sim/test");
+  CHECK_EQUAL('s', pgm_read_byte((const char *)name));
+  char tmp[32];
+  CHECK_STRING("-1234", ltoa(-1234, tmp, 10));
+  CHECK_STRING("4294967295", ultoa(4294967295UL, tmp, 10));
+  CHECK_STRING("  -1.50", dtostrf(-1.5, 7, 2, tmp));
+
+  HostStream stream;
+  CHECK_EQUAL(0, stream.availableForWrite());
+  stream.inject("ab");
+  CHECK_EQUAL(2, stream.available());
+  CHECK_EQUAL('a', stream.read());
+  stream.print(42);
+  stream.print(F("x"));
+  CHECK_STRING("42x", stream.take());
+  CHECK_STRING("", stream.take());
+}
+
+static void testDevices()
+{
+  hostReset();
+  Button button(2);
+  Switch toggle(3);
+  Encoder encoder(NOT_USED, 4, 5, NOT_USED, enc4Pulse);
+  AnalogIn analog(A1, unipolar);
+  ShiftOut shiftOut(8, 9, 10, 8);
+  Timer timer(10);
+
+  hostSetPin(2, LOW); // inputs are active low
+  button.handle();
+  CHECK(button.pressed());
+  hostSetPin(2, HIGH);
+  for (int i = 0; i < 100; i++)
+  {
+    button.handle();
+  }
+  CHECK(button.released());
+
+  hostSetPin(3, LOW);
+  toggle.handle();
+  CHECK(toggle.on());
+
+  // one detent clockwise on a 4 pulse encoder
+  const bool a[] = {LOW, LOW, HIGH, HIGH};
+  const bool b[] = {HIGH, LOW, LOW, HIGH};
+  for (int step = 0; step < 4; step++)
+  {
+    hostSetPin(4, a[step]);
+    hostSetPin(5, b[step]);
+    encoder.handle();
+  }
+  CHECK(encoder.pos() != 0);
+
+  hostSetAnalog(A1, 1023);
+  analog.handle();
+  CHECK(analog.value() > 0.99);
+
+  shiftOut.setPin(0, true);
+  shiftOut.handle();
+  CHECK(hostGetPin(8)); // pin 0 is shifted out last
+
+  CHECK(!timer.elapsed());
+  hostAdvanceMillis(11);
+  CHECK(timer.elapsed());
+}
+
+static void testXPLDirect()
+{
+  hostReset();
+  HostStream link;
+  XP.begin("Host", &link);
+  link.inject("<a>");
+  XP.xloop();
+  CHECK_STRING("<0Host>", link.take());
+  CHECK_EQUAL(1, XP.connectionStatus());
+}
+
+int main()
+{
+  testShim();
+  testDevices();
+  testXPLDirect();
+  return hostTestResult();
+}
@@ -0,0 +1,119 @@
+// MCP23017 on the I2C stand-in: register setup in one transmission, and reads only when the interrupt line
+// signals a change. Bus transactions are counted for an idle panel, for changes and for an MCP without
+// interrupt line, which is read on every handle().
+#include <XPLDevices.h>
+#include "HostTest.h"
+#include "McpModel.h"
+
+#define INT_PIN 2
+#define INT_PIN_SHARED 3
+#define LOOPS 1000
+
+static unsigned long transactions()
+{
+  return hostCounters.i2cTransmissions + hostCounters.i2cRequests;
+}
+
+static unsigned long handle(DigitalIn_ &inputs, int loops)
+{
+  unsigned long start = transactions();
+  for (int loop = 0; loop < loops; loop++)
+  {
+    inputs.handle();
+  }
+  return transactions() - start;
+}
+
+static void testSetup()
+{
+  hostReset();
+  Wire.hostDetachAll();
+  DigitalIn_ inputs;
+  McpModel mcp(0x20, INT_PIN);
+  mcp.set(0x8001);
+
+  // address probe, all registers in one write, initial read
+  CHECK(inputs.addMCP(0x20, INT_PIN));
+  CHECK_EQUAL(3, hostCounters.i2cTransmissions);
+  CHECK_EQUAL(1, hostCounters.i2cRequests);
+  const uint8_t expected[14] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0, 0x44, 0x44, 0xFF, 0xFF};
+  for (uint8_t address = 0; address < sizeof(expected); address++)
+  {
+    CHECK_EQUAL(expected[address], mcp.reg(address));
+  }
+  CHECK(inputs.getBit(0, 0) && inputs.getBit(0, 15) && !inputs.getBit(0, 1));
+
+  // no device at the address
+  unsigned long start = transactions();
+  CHECK(!inputs.addMCP(0x21, NOT_USED));
+  CHECK_EQUAL(1, transactions() - start);
+}
+
+static void testInterruptLine()
+{
+  hostReset();
+  Wire.hostDetachAll();
+  DigitalIn_ inputs;
+  McpModel mcp(0x20, INT_PIN);
+  CHECK(inputs.addMCP(0x20, INT_PIN));
+
+  // idle panel
+  unsigned long idle = handle(inputs, LOOPS);
+  printf("idle, %d loops: %lu transactions with interrupt line\n", LOOPS, idle);
+  CHECK_EQUAL(0, idle);
+
+  // one read per change, the read clears the interrupt
+  mcp.set(0x0005);
+  CHECK(!digitalRead(INT_PIN));
+  CHECK_EQUAL(2, handle(inputs, 1));
+  CHECK(digitalRead(INT_PIN));
+  CHECK(inputs.getBit(0, 0) && !inputs.getBit(0, 1) && inputs.getBit(0, 2));
+  CHECK_EQUAL(0x0005, (uint16_t)inputs.getChanges(0));
+  CHECK_EQUAL(0, handle(inputs, LOOPS));
+  mcp.set(0x0004);
+  CHECK_EQUAL(2, handle(inputs, LOOPS));
+  CHECK(!inputs.getBit(0, 0) && inputs.getBit(0, 2));
+}
+
+static void testPolling()
+{
+  hostReset();
+  Wire.hostDetachAll();
+  DigitalIn_ inputs;
+  McpModel mcp(0x20, NOT_USED);
+  CHECK(inputs.addMCP(0x20));
+  unsigned long polled = handle(inputs, LOOPS);
+  printf("idle, %d loops: %lu transactions without interrupt line\n", LOOPS, polled);
+  CHECK_EQUAL(2 * LOOPS, polled);
+  mcp.set(0x1000);
+  inputs.handle();
+  CHECK(inputs.getBit(0, 12));
+}
+
+static void testSharedLine()
+{
+  hostReset();
+  Wire.hostDetachAll();
+  DigitalIn_ inputs;
+  McpModel first(0x20, INT_PIN_SHARED);
+  McpModel second(0x21, INT_PIN_SHARED);
+  CHECK(inputs.addMCP(0x20, INT_PIN_SHARED));
+  CHECK(inputs.addMCP(0x21, INT_PIN_SHARED));
+  CHECK_EQUAL(0, handle(inputs, LOOPS));
+
+  // a change on one pulls the shared line, both are read once
+  second.set(0x0100);
+  CHECK(!digitalRead(INT_PIN_SHARED));
+  CHECK_EQUAL(4, handle(inputs, LOOPS));
+  CHECK(digitalRead(INT_PIN_SHARED));
+  CHECK(!inputs.getBit(0, 8) && inputs.getBit(1, 8));
+}
+
+int main()
+{
+  testSetup();
+  testInterruptLine();
+  testPolling();
+  testSharedLine();
+  return hostTestResult();
+}
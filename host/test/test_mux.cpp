@@ -0,0 +1,73 @@
+// Mux scan against a model of the 74HC4067 on the port registers of the shim: 1-6 mux with the address lines
+// on one port or split over two, data pins on one port or spread over several, one of them shared with the
+// address lines. Built with ARDUINO_ARCH_AVR for the port-wide reads, and without for the digitalRead() path.
+#include <XPLDevices.h>
+#include "HostTest.h"
+#include "MuxModel.h"
+
+static const uint8_t addressOnePort[4] = {24, 25, 26, 27};
+static const uint8_t addressSplit[4] = {22, 23, 24, 25};
+static const uint8_t dataOnePort[6] = {40, 41, 42, 43, 44, 45};
+static const uint8_t dataSpread[6] = {28, 38, 50, 29, 60, 51};
+
+static uint32_t seed = 99;
+static uint16_t random16()
+{
+  seed = seed * 1664525 + 1013904223;
+  return seed >> 16;
+}
+
+static void test(const uint8_t *address, const uint8_t *data, int count)
+{
+  hostReset();
+  DigitalIn_ mux;
+  mux.setMux(address[0], address[1], address[2], address[3]);
+  for (int m = 0; m < count; m++)
+  {
+    CHECK(mux.addMux(data[m]));
+  }
+  MuxModel::attach(address, data, count);
+  uint16_t previous[6] = {0};
+  int failures = 0;
+  for (int run = 0; run < 50; run++)
+  {
+    for (int m = 0; m < count; m++)
+    {
+      MuxModel::inputs[m] = run == 0 ? 0xFFFF : run == 1 ? 0x0000 : random16();
+    }
+    mux.handle();
+    for (int m = 0; m < count; m++)
+    {
+      for (int channel = 0; channel < 16; channel++)
+      {
+        if (mux.getBit(m, channel) != (bool)((MuxModel::inputs[m] >> channel) & 1))
+        {
+          failures++;
+        }
+      }
+      if ((uint16_t)mux.getChanges(m) != (uint16_t)(MuxModel::inputs[m] ^ previous[m]))
+      {
+        failures++;
+      }
+      previous[m] = MuxModel::inputs[m];
+    }
+  }
+  if (failures > 0)
+  {
+    printf("%d mux, address %d-%d, first data pin %d: %d wrong inputs\n", count, address[0], address[3], data[0],
+           failures);
+  }
+  CHECK_EQUAL(0, failures);
+}
+
+int main()
+{
+  for (int count = 1; count <= 6; count++)
+  {
+    test(addressOnePort, dataOnePort, count);
+    test(addressOnePort, dataSpread, count);
+    test(addressSplit, dataOnePort, count);
+    test(addressSplit, dataSpread, count);
+  }
+  return hostTestResult();
+}
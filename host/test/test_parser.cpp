@@ -0,0 +1,167 @@
+// Receive side framing: a plugin session is fed in random splits with xloop() calls in between and has to give
+// the same result as feeding it at once. A '<' inside a frame is payload, strings may contain it. Oversized
+// frames and lost trailers cost the frames up to the next trailer or to a stall of the sender.
+#include <XPLDevices.h>
+#include "HostTest.h"
+
+// legacy plugin session: handshake, registration of three datarefs and a command, updates, with line noise
+static const char session[] =
+    "<a>\r\n<v>\r\n"
+    "<f><3000sim/test/int>\r\n"
+    "<f><3001sim/test/float>\r\n"
+    "<f><3002sim/test/string>\r\n"
+    "<f><4003sim/test/command>\r\n"
+    "<f>\r\n"
+    "<e000123><e0011.500000>\r\n<e002hello world>xx\r\n"
+    "<e000-7><e001-0.250000>\r\n<d>\r\n<e0021 < 2>"
+    "<e000 42>\r\n";
+
+static HostStream link;
+static long intValue;
+static float floatValue;
+static char stringValue[16];
+static int command;
+
+static uint32_t seed = 12345;
+static int random(int range)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return (int)(seed % range);
+}
+
+static void setup()
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  intValue = 0;
+  floatValue = 0;
+  memset(stringValue, 0, sizeof(stringValue));
+  XP.begin("Parser", &link);
+  XP.registerDataRef(F("sim/test/int"), XPL_READ, 100, 1, &intValue);
+  XP.registerDataRef(F("sim/test/float"), XPL_READ, 100, 1, &floatValue);
+  XP.registerDataRef(F("sim/test/string"), XPL_READ, 100, stringValue);
+  command = XP.registerCommand(F("sim/test/command"));
+}
+
+static void feed(const char *data, int length)
+{
+  link.inject(data, length);
+  XP.xloop();
+}
+
+static void feed(const char *data)
+{
+  feed(data, strlen(data));
+}
+
+struct Result
+{
+  std::string sent;
+  long intValue;
+  float floatValue;
+  std::string stringValue;
+  unsigned int malformed;
+  unsigned int oversize;
+  unsigned int dropped;
+};
+
+static Result result()
+{
+  XP.commandTrigger(command); // registered handle shows in the frame
+  XP.xloop();
+  Result r;
+  r.sent = link.take();
+  r.intValue = intValue;
+  r.floatValue = floatValue;
+  r.stringValue = stringValue;
+  r.malformed = XP.rxMalformedFrames();
+  r.oversize = XP.rxOversizeFrames();
+  r.dropped = XP.rxDroppedFrames();
+  return r;
+}
+
+static void testSession()
+{
+  setup();
+  feed(session);
+  Result whole = result();
+  CHECK(XP.allDataRefsRegistered());
+  CHECK_EQUAL(42, whole.intValue); // " 42" parsed like atol
+  CHECK(whole.floatValue == -0.25f);
+  CHECK_STRING("1 < 2", whole.stringValue.c_str());
+  CHECK_EQUAL(0, whole.oversize);
+  CHECK_EQUAL(0, whole.dropped);
+  CHECK(whole.sent.find("<k003") != std::string::npos);
+  CHECK_EQUAL(0, whole.malformed);
+
+  for (int run = 0; run < 500; run++)
+  {
+    setup();
+    int length = strlen(session);
+    for (int pos = 0; pos < length;)
+    {
+      int chunk = 1 + random(20); // drawn once, min() is a macro
+      chunk = min(length - pos, chunk);
+      feed(session + pos, chunk);
+      pos += chunk;
+      hostAdvanceMillis(random(4)); // well below XPLDIRECT_RX_TIMEOUT
+    }
+    Result split = result();
+    CHECK(split.sent == whole.sent);
+    CHECK_EQUAL(whole.intValue, split.intValue);
+    CHECK(split.floatValue == whole.floatValue);
+    CHECK(split.stringValue == whole.stringValue);
+    CHECK_EQUAL(whole.malformed, split.malformed);
+    if (hostTestFailures > 0)
+    {
+      printf("failed in run %d\n", run);
+      break;
+    }
+  }
+}
+
+static void testResync()
+{
+  setup();
+  feed(session);
+  unsigned int malformed = XP.rxMalformedFrames();
+
+  // trailer lost, the timeout ends the frame and the next one is received
+  feed("<e01");
+  hostAdvanceMillis(XPLDIRECT_RX_TIMEOUT + 1);
+  XP.xloop();
+  CHECK_EQUAL(malformed + 1, XP.rxMalformedFrames());
+  feed("<e000125>");
+  CHECK_EQUAL(125, intValue);
+
+  // oversized frame with lost trailer, the next frame is discarded with it
+  std::string oversized = "<e002";
+  oversized.append(XPLMAX_PACKETSIZE, 'x');
+  oversized += "<e000126>";
+  feed(oversized.c_str());
+  CHECK_EQUAL(125, intValue);
+  CHECK_EQUAL(1, XP.rxOversizeFrames());
+  feed("<e000127>");
+  CHECK_EQUAL(127, intValue);
+  CHECK_EQUAL(malformed + 1, XP.rxMalformedFrames());
+
+  // sender stalls in a frame, the rest arriving later is noise
+  feed("<e000");
+  hostAdvanceMillis(XPLDIRECT_RX_TIMEOUT + 1);
+  XP.xloop();
+  CHECK_EQUAL(malformed + 2, XP.rxMalformedFrames());
+  feed("128>");
+  CHECK_EQUAL(127, intValue);
+  feed("<e000129>");
+  CHECK_EQUAL(129, intValue);
+}
+
+int main()
+{
+  testSession();
+  testResync();
+  return hostTestResult();
+}
@@ -0,0 +1,125 @@
+// RAM of the static pools: XPLDirect is compiled with different limits, the size grows linearly per dataref and
+// command and everything else is a small fixed part. Prints the cost per entry on the host and the bytes saved
+// against the former layout, with pointer tables sized by the limit and one heap block per registration.
+#include <Arduino.h>
+#include "HostTest.h"
+
+namespace small
+{
+#define XPLDIRECT_MAXDATAREFS_ARDUINO 10
+#define XPLDIRECT_MAXCOMMANDS_ARDUINO 10
+#include <XPLDirect.h>
+const size_t size = sizeof(XPLDirect);
+}
+#undef XPLDirect_h
+#undef XPLDIRECT_MAXDATAREFS_ARDUINO
+#undef XPLDIRECT_MAXCOMMANDS_ARDUINO
+#undef XPLDIRECT_MAXHANDLES
+
+namespace moreDataRefs
+{
+#define XPLDIRECT_MAXDATAREFS_ARDUINO 50
+#define XPLDIRECT_MAXCOMMANDS_ARDUINO 10
+#include <XPLDirect.h>
+const size_t size = sizeof(XPLDirect);
+}
+#undef XPLDirect_h
+#undef XPLDIRECT_MAXDATAREFS_ARDUINO
+#undef XPLDIRECT_MAXCOMMANDS_ARDUINO
+#undef XPLDIRECT_MAXHANDLES
+
+namespace moreCommands
+{
+#define XPLDIRECT_MAXDATAREFS_ARDUINO 10
+#define XPLDIRECT_MAXCOMMANDS_ARDUINO 50
+#include <XPLDirect.h>
+const size_t size = sizeof(XPLDirect);
+}
+#undef XPLDirect_h
+#undef XPLDIRECT_MAXDATAREFS_ARDUINO
+#undef XPLDIRECT_MAXCOMMANDS_ARDUINO
+#undef XPLDIRECT_MAXHANDLES
+
+namespace large
+{
+#define XPLDIRECT_MAXDATAREFS_ARDUINO 90
+#define XPLDIRECT_MAXCOMMANDS_ARDUINO 90
+#include <XPLDirect.h>
+const size_t size = sizeof(XPLDirect);
+}
+
+// entries of the former layout as allocated with new per registration, pointers and names as void *
+namespace heap
+{
+struct DataRef
+{
+  int dataRefHandle;
+  byte dataRefRWType;
+  byte dataRefVARType;
+  float divider;
+  byte forceUpdate;
+  unsigned long updateRate;
+  unsigned long lastUpdateTime;
+  unsigned long nextUpdateTime;
+  const void *dataRefName;
+  unsigned int nameHash;
+  void *latestValue;
+  long int lastSentValue;
+  byte updatedFlag;
+  byte arrayIndex;
+  byte registerPending;
+  byte queued;
+  byte dirty;
+  byte explicitDirty;
+};
+struct Command
+{
+  int commandHandle;
+  const void *commandName;
+  unsigned int nameHash;
+  byte registerPending;
+};
+
+// heap block with the size header of the allocator, aligned to two words like glibc
+size_t block(size_t size)
+{
+  size_t align = 2 * sizeof(size_t);
+  return max((size + sizeof(size_t) + align - 1) / align * align, 4 * sizeof(size_t));
+}
+
+// pointer tables for limit entries, the others of the former class (handle map, due heap) were static too
+size_t layout(int limit, int dataRefs, int commands)
+{
+  return 2 * limit * sizeof(void *) + dataRefs * block(sizeof(DataRef)) + commands * block(sizeof(Command)) +
+         2 * limit; // handle map and due heap with byte indexes
+}
+}
+
+int main()
+{
+  double perDataRef = (moreDataRefs::size - small::size) / 40.0;
+  double perCommand = (moreCommands::size - small::size) / 40.0;
+  double fixed = small::size - 10 * perDataRef - 10 * perCommand;
+  printf("host: %.2f bytes per dataref, %.2f per command, %.0f fixed\n", perDataRef, perCommand, fixed);
+
+  // linear, with up to a few bytes of alignment
+  CHECK(fabs(large::size - (fixed + 90 * perDataRef + 90 * perCommand)) <= 8);
+  // 64 bit host, pointers and longs take twice the space of 32 bit boards (56 and 16 bytes) and AVR (42 and 7)
+  CHECK(perDataRef <= 80);
+  CHECK(perCommand <= 24);
+  CHECK(fixed <= 512);
+
+  // all 90 entries registered, the static pools against the heap blocks they replace
+  size_t former = heap::layout(90, 90, 90);
+  size_t pools = 90 * perDataRef + 90 * perCommand;
+  printf("host: 90 datarefs and commands, former heap layout %zu bytes, static pools %zu bytes, saved %ld\n", former,
+         pools, (long)former - (long)pools);
+  // AVR, from the per entry figures in XPLDirect.h: 2 byte pointers, 37 byte dataref and 7 byte command blocks
+  // with 2 bytes of malloc header each, pointer tables and byte indexes for the former limit of 100
+  const long avrFormer = 4 * 100 + 2 * 100 + 100 * (37 + 2) + 100 * (7 + 2);
+  const long avrPools[] = {10 * (42 + 7), 50 * (42 + 7), 100 * (42 + 7)};
+  printf("AVR: former layout with 100 datarefs and commands %ld bytes, pools with limit 10 %ld, 50 %ld, 100 %ld\n",
+         avrFormer, avrPools[0], avrPools[1], avrPools[2]);
+  CHECK(pools < former);
+  return hostTestResult();
+}
@@ -0,0 +1,82 @@
+// Loop profiler, built with XPL_PROFILE=1: the probes of xloop() and DigitalIn.handle() and a probe of the sketch
+// collect min/max/mean on the virtual clock, the loop periods fill the histogram, report() sends one debug
+// message per probe and restarts the measurement.
+#include <XPLDevices.h>
+#include "HostTest.h"
+
+static HostStream link;
+
+static std::vector<std::string> messages()
+{
+  std::vector<std::string> result;
+  std::string data = link.take();
+  for (size_t start = 0, end; (start = data.find("<1", start)) != std::string::npos &&
+                              (end = data.find('>', start)) != std::string::npos;
+       start = end + 1)
+  {
+    result.push_back(data.substr(start + 2, end - start - 2));
+  }
+  return result;
+}
+
+static bool contains(const std::vector<std::string> &lines, const std::string &line)
+{
+  return std::find(lines.begin(), lines.end(), line) != lines.end();
+}
+
+static void sketchWork(unsigned long us)
+{
+  XPL_PROFILE_SCOPE("work");
+  hostAdvanceMicros(us);
+}
+
+int main()
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 256;
+  XP.begin("Profiler", &link);
+  link.inject("<a><f>");
+
+  // loop periods of 200, 700 and 1200 us fall into the first three buckets
+  const unsigned long work[] = {200, 700, 1200};
+  hostAdvanceMillis(1); // a loop at micros() 0 counts as the first one
+  XPL_PROFILE_LOOP();
+  for (int round = 0; round < 2; round++)
+  {
+    for (unsigned long us : work)
+    {
+      XP.xloop();
+      DigitalIn.handle();
+      sketchWork(us);
+      XPL_PROFILE_LOOP();
+    }
+  }
+  link.take();
+  XPL_PROFILE_REPORT();
+  std::vector<std::string> lines = messages();
+  CHECK_EQUAL(5, (int)lines.size());
+  CHECK(contains(lines, "xloop n=6 0/0/0 us"));
+  CHECK(contains(lines, "DigitalIn n=6 0/0/0 us"));
+  CHECK(contains(lines, "work n=6 200/1200/700 us"));
+  CHECK(contains(lines, "loop n=6 200/1200/700 us"));
+  CHECK(contains(lines, "hist 500us 2 2 2 0 0 0 0 0"));
+
+  // restarted, the probes stay registered
+  XPL_PROFILE_REPORT();
+  lines = messages();
+  CHECK_EQUAL(5, (int)lines.size());
+  CHECK(contains(lines, "work n=0"));
+  CHECK(contains(lines, "loop n=0"));
+  CHECK(contains(lines, "hist 500us 0 0 0 0 0 0 0 0"));
+
+  // the first loop after the restart only sets the start
+  XPL_PROFILE_LOOP();
+  hostAdvanceMicros(4000);
+  XPL_PROFILE_LOOP();
+  XPL_PROFILE_REPORT();
+  lines = messages();
+  CHECK(contains(lines, "loop n=1 4000/4000/4000 us"));
+  CHECK(contains(lines, "hist 500us 0 0 0 0 0 0 0 1"));
+  return hostTestResult();
+}
@@ -0,0 +1,89 @@
+// Reconnects: written datarefs, polled and marked with markDirty(), are sent again once the plugin asked for
+// the name again and registration completed, to the same or to new handles. A legacy plugin taking over from
+// a capable one only gets frames of the baseline protocol.
+#include <XPLDevices.h>
+#include "HostTest.h"
+#include "PluginStandIn.h"
+
+static HostStream link;
+static long polled;
+static long marked;
+static int markedHandle;
+
+static bool registered()
+{
+  return XP.allDataRefsRegistered() != 0;
+}
+
+static void change(PluginStandIn &plugin, long value)
+{
+  polled = value;
+  marked = value;
+  XP.markDirty(markedHandle);
+  plugin.run(100000);
+}
+
+// frames a plugin without the protocol extensions understands
+static bool baseline(const std::string &frame)
+{
+  return strchr("0Vbmceijk1S", frame[1]) != NULL;
+}
+
+static void check(PluginStandIn &plugin, long value)
+{
+  CHECK_EQUAL(value, plugin.intValue(plugin.dataRefHandle("sim/test/polled")));
+  CHECK_EQUAL(value, plugin.intValue(plugin.dataRefHandle("sim/test/marked")));
+}
+
+int main()
+{
+  hostReset();
+  link.writeSpace = 64;
+  XP.begin("Reconnect", &link);
+  XP.registerDataRef(F("sim/test/polled"), XPL_WRITE, 0, 1, &polled);
+  markedHandle = XP.registerDataRef(F("sim/test/marked"), XPL_WRITE, 0, 1, &marked);
+  XP.markDirty(markedHandle);
+
+  PluginStandIn plugin(XP, link);
+  plugin.offer = XPL_CAP_PIPELINE | XPL_CAP_MULTIUPDATE;
+  plugin.connect();
+  CHECK(plugin.runUntil(registered, 2000000));
+  change(plugin, 1);
+  check(plugin, 1);
+
+  // plugin asks for the name again, e.g. after loading a new aircraft
+  plugin.connect();
+  plugin.run(10000);
+  CHECK(!registered());
+  change(plugin, 2); // marked while registration is running
+  CHECK(plugin.runUntil(registered, 2000000));
+  plugin.run(100000);
+  check(plugin, 2);
+  change(plugin, 3);
+  check(plugin, 3);
+  CHECK(XP.handshakeTime() > 0);
+
+  CHECK_EQUAL(XPL_CAP_PIPELINE | XPL_CAP_MULTIUPDATE, plugin.capabilities);
+
+  // X-Plane crashed without 'x' and was restarted with a legacy plugin, which hands out other handles
+  PluginStandIn restarted(XP, link);
+  restarted.handleBase = 50;
+  restarted.connect();
+  restarted.run(10000);
+  CHECK(!registered());
+  CHECK(restarted.runUntil(registered, 2000000));
+  change(restarted, 4);
+  check(restarted, 4);
+  CHECK_EQUAL(50, restarted.dataRefHandle("sim/test/polled"));
+  CHECK(restarted.frames.size() > 4);
+  for (const std::string &frame : restarted.frames)
+  {
+    if (!baseline(frame))
+    {
+      printf("legacy plugin received %s\n", frame.c_str());
+    }
+    CHECK(baseline(frame));
+  }
+  CHECK(restarted.registrations + restarted.noRequests <= restarted.polls); // one request per poll
+  return hostTestResult();
+}
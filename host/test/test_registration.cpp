@@ -0,0 +1,247 @@
+// Pipelined registration: windows of requests per poll, outstanding requests tracked until their handle
+// arrives, lost responses requested again, every poll answered, legacy plugins served one request per poll.
+// Array elements share their name, responses of one element never bind to another. Registrations beyond the
+// pool limits are counted and reported to the plugin log.
+#include <XPLDevices.h>
+#include "HostTest.h"
+#include "PluginStandIn.h"
+
+#define REFS 10
+
+static HostStream link;
+static char names[REFS][24];
+static long values[REFS];
+
+static void setup()
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Registration", &link);
+  for (int i = 0; i < REFS; i++)
+  {
+    snprintf(names[i], sizeof(names[i]), "sim/test/ref%02d", i);
+    XP.registerDataRef((XPString_t *)names[i], XPL_READ, 100, 1, &values[i]);
+  }
+}
+
+// frames sent by the device for one received frame, in as many loops as the stream needs
+static std::vector<std::string> exchange(const char *frame)
+{
+  link.inject(frame);
+  std::string data;
+  for (int loop = 0; loop < 20; loop++)
+  {
+    XP.xloop();
+    data += link.take();
+  }
+  std::vector<std::string> sent;
+  for (size_t start = 0, end; (start = data.find('<', start)) != std::string::npos &&
+                              (end = data.find('>', start)) != std::string::npos;
+       start = end + 1)
+  {
+    sent.push_back(data.substr(start, end - start + 1));
+  }
+  return sent;
+}
+
+// first frame sent for one received frame
+static std::string answer(const char *frame)
+{
+  std::vector<std::string> sent = exchange(frame);
+  return sent.empty() ? "" : sent[0];
+}
+
+static void respond(int first, int count)
+{
+  char frame[40];
+  for (int i = first; i < first + count; i++)
+  {
+    snprintf(frame, sizeof(frame), "<3%03d%s>", i, names[i]);
+    exchange(frame);
+  }
+}
+
+static void testWindow()
+{
+  setup();
+  exchange("<a>");
+  CHECK(answer("<C0001>") == "<C0001>");
+  CHECK_EQUAL(XPLDIRECT_REGISTER_WINDOW, exchange("<f>").size());
+  CHECK_EQUAL(REFS - XPLDIRECT_REGISTER_WINDOW, exchange("<f>").size());
+
+  // all requests outstanding, the poll is answered anyway
+  std::vector<std::string> sent = exchange("<f>");
+  CHECK_EQUAL(1, sent.size());
+  CHECK(sent.size() == 1 && sent[0] == "<c>");
+  CHECK(!XP.allDataRefsRegistered());
+
+  respond(0, REFS);
+  sent = exchange("<f>");
+  CHECK_EQUAL(1, sent.size());
+  CHECK(sent.size() == 1 && sent[0] == "<c>");
+  CHECK(XP.allDataRefsRegistered());
+}
+
+static void testLostResponses()
+{
+  setup();
+  exchange("<a>");
+  exchange("<C0001>");
+  exchange("<f>");
+  exchange("<f>");
+  respond(0, 4); // the others got lost
+  for (int poll = 1; poll < XPLDIRECT_REGISTER_RETRY; poll++)
+  {
+    CHECK(answer("<f>") == "<c>");
+  }
+  // given up waiting, the rest is requested again
+  CHECK(answer("<f>") == "<c>");
+  std::vector<std::string> sent = exchange("<f>");
+  CHECK_EQUAL(REFS - 4, sent.size());
+  CHECK(sent.size() > 0 && sent[0].find(names[4]) != std::string::npos);
+  respond(4, REFS - 4);
+  exchange("<f>");
+  CHECK(XP.allDataRefsRegistered());
+}
+
+static void testArrayRetry()
+{
+  static long elements[3];
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Registration", &link);
+  for (int e = 0; e < 3; e++)
+  {
+    XP.registerDataRef(F("sim/test/array"), XPL_READ, 100, 1, &elements[e], e);
+  }
+  exchange("<a>");
+  exchange("<C0001>");
+  // one element after the other, the response does not tell the index
+  std::vector<std::string> sent = exchange("<f>");
+  CHECK_EQUAL(1, sent.size());
+  CHECK(sent.size() == 1 && sent[0].compare(0, 5, "<b100") == 0);
+
+  // response lost, the request is sent again
+  for (int poll = 0; poll < XPLDIRECT_REGISTER_RETRY; poll++)
+  {
+    CHECK(answer("<f>") == "<c>");
+  }
+  sent = exchange("<f>");
+  CHECK_EQUAL(1, sent.size());
+  CHECK(sent.size() == 1 && sent[0].compare(0, 5, "<b100") == 0);
+
+  // the late response and the one to the retry, the duplicate must not take element 1
+  exchange("<3007sim/test/array>");
+  exchange("<3007sim/test/array>");
+  sent = exchange("<f>");
+  CHECK_EQUAL(1, sent.size());
+  CHECK(sent.size() == 1 && sent[0].compare(0, 5, "<b101") == 0);
+  exchange("<3008sim/test/array>");
+  sent = exchange("<f>");
+  CHECK(sent.size() == 1 && sent[0].compare(0, 5, "<b102") == 0);
+  exchange("<3009sim/test/array>");
+  exchange("<f>");
+  CHECK(XP.allDataRefsRegistered());
+
+  exchange("<e0071>");
+  exchange("<e0082>");
+  exchange("<e0093>");
+  CHECK_EQUAL(1, elements[0]);
+  CHECK_EQUAL(2, elements[1]);
+  CHECK_EQUAL(3, elements[2]);
+  CHECK_EQUAL(0, XP.rxDroppedFrames());
+}
+
+static void testPoolFull()
+{
+  static long pool[XPLDIRECT_MAXDATAREFS_ARDUINO + 2];
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Registration", &link);
+  for (int i = 0; i < XPLDIRECT_MAXDATAREFS_ARDUINO; i++)
+  {
+    CHECK_EQUAL(i, XP.registerDataRef(F("sim/test/pool"), XPL_READ, 100, 1, &pool[i], i));
+  }
+  CHECK_EQUAL(-1, XP.registerDataRef(F("sim/test/pool"), XPL_READ, 100, 1, &pool[0], 0, 2));
+  CHECK_EQUAL(2, XP.registrationsDropped());
+  for (int i = 0; i < XPLDIRECT_MAXCOMMANDS_ARDUINO; i++)
+  {
+    XP.registerCommand(F("sim/test/command"));
+  }
+  CHECK_EQUAL(-1, XP.registerCommand(F("sim/test/command")));
+  CHECK_EQUAL(3, XP.registrationsDropped());
+  std::vector<std::string> sent = exchange("<a>");
+  CHECK_EQUAL(2, sent.size());
+  CHECK(sent.size() == 2 && sent[1] == "<1XPLDirect pools full, dropped: 3>");
+}
+
+static void testReconnect()
+{
+  setup();
+  exchange("<a>");
+  exchange("<C0001>");
+  exchange("<f>");
+  exchange("<f>");
+  respond(0, REFS);
+  exchange("<f>");
+  CHECK(XP.allDataRefsRegistered());
+
+  // requests of the old connection are not outstanding any more, the new one starts right away
+  exchange("<a>");
+  exchange("<C0001>");
+  CHECK_EQUAL(XPLDIRECT_REGISTER_WINDOW, exchange("<f>").size());
+
+  // same when the plugin restarts while responses are outstanding
+  exchange("<a>");
+  exchange("<C0001>");
+  CHECK_EQUAL(XPLDIRECT_REGISTER_WINDOW, exchange("<f>").size());
+}
+
+static void testLegacy()
+{
+  setup();
+  exchange("<a>");
+  for (int i = 0; i < REFS; i++)
+  {
+    std::vector<std::string> sent = exchange("<f>");
+    CHECK_EQUAL(1, sent.size());
+    CHECK(sent.size() > 0 && sent[0].find(names[i]) != std::string::npos);
+    respond(i, 1);
+  }
+  CHECK(answer("<f>") == "<c>");
+  CHECK(XP.allDataRefsRegistered());
+}
+
+static void testStandIn()
+{
+  setup();
+  XP.registerCommand(F("sim/test/command"));
+  PluginStandIn plugin(XP, link);
+  plugin.offer = XPL_CAP_PIPELINE;
+  plugin.answerRegistrations = false;
+  plugin.connect();
+  plugin.run(200000);
+  CHECK(!XP.allDataRefsRegistered());
+  plugin.answerRegistrations = true;
+  CHECK(plugin.runUntil([]()
+                        { return XP.allDataRefsRegistered() != 0; },
+                        5000000));
+  CHECK_EQUAL(REFS, plugin.dataRefs.size());
+  CHECK_EQUAL(1, plugin.commands.size());
+  CHECK(plugin.noRequests > 0);
+}
+
+int main()
+{
+  testWindow();
+  testLostResponses();
+  testArrayRetry();
+  testPoolFull();
+  testReconnect();
+  testLegacy();
+  testStandIn();
+  return hostTestResult();
+}
@@ -0,0 +1,133 @@
+// Capture and replay: a session with the plugin stand-in is recorded with XPLCapture and dumped to a file
+// while it runs, then the file is replayed into XPLDirect with XPLReplay on the virtual clock. Received data
+// must arrive no earlier than recorded and the device must send the recorded data again.
+#include <XPLDevices.h>
+#include "HostTest.h"
+#include "PluginStandIn.h"
+
+#define CAPTURE_FILE "test_replay.cap"
+
+static HostStream link;
+static long readValue;
+static long writeValue;
+static int command;
+
+static bool registered()
+{
+  return XP.allDataRefsRegistered() != 0;
+}
+
+static void setup(Stream *stream)
+{
+  XP.begin("Replay", stream);
+  XP.registerDataRef(F("sim/test/read"), XPL_READ, 100, 1, &readValue);
+  XP.registerDataRef(F("sim/test/write"), XPL_WRITE, 100, 1, &writeValue);
+  command = XP.registerCommand(F("sim/test/command"));
+  readValue = 0;
+  writeValue = 0;
+}
+
+// the sketch changes its written dataref every 50 ms after registration and triggers the command every 250 ms
+static void sketch(unsigned long registeredTime, int *step)
+{
+  int next = (millis() - registeredTime) / 50 + 1;
+  if (next > *step && next <= 20)
+  {
+    *step = next;
+    writeValue = next;
+    if (next % 5 == 0)
+    {
+      XP.commandTrigger(command);
+    }
+  }
+}
+
+// plugin stand-in session, returns the virtual time when registration completed
+static unsigned long record()
+{
+  hostReset();
+  link.writeSpace = 64;
+  XPLCapture capture(&link);
+  setup(&capture);
+  HostFile file(CAPTURE_FILE, "wb");
+  CHECK(file.isOpen());
+
+  PluginStandIn plugin(XP, link);
+  plugin.offer = XPL_CAP_PIPELINE;
+  plugin.connect();
+  while (!registered() && millis() < 2000)
+  {
+    plugin.step();
+    capture.dump(&file);
+  }
+  unsigned long registeredTime = millis();
+  int step = 0;
+  int sent = 0;
+  while (millis() < registeredTime + 1100)
+  {
+    if (sent < step && plugin.dataRefHandle("sim/test/read") >= 0)
+    {
+      sent = step;
+      plugin.updateInt(plugin.dataRefHandle("sim/test/read"), step * 11);
+    }
+    sketch(registeredTime, &step);
+    plugin.step();
+    capture.dump(&file);
+  }
+  CHECK_EQUAL(220, readValue);
+  CHECK_EQUAL(20, plugin.intValue(plugin.dataRefHandle("sim/test/write")));
+  CHECK_EQUAL(4, plugin.command(plugin.commandHandle("sim/test/command")).triggers);
+  CHECK_EQUAL(0, capture.dropped());
+  return registeredTime;
+}
+
+static void replay(unsigned long registeredTime)
+{
+  std::vector<uint8_t> data = HostFile::load(CAPTURE_FILE);
+  CHECK(data.size() > 200);
+  hostReset();
+  XPLReplay replay(data.data(), (int)data.size());
+  setup(&replay);
+
+  // same loop timing as the stand-in
+  unsigned long replayedRegistration = 0;
+  int step = 0;
+  bool stopped = false;
+  while (millis() < registeredTime + 1200)
+  {
+    if (readValue == 11 && !stopped)
+    { // the next value is recorded 50 ms later, it does not arrive while the clock stands still
+      stopped = true;
+      for (int loop = 0; loop < 1000; loop++)
+      {
+        XP.xloop();
+      }
+      CHECK_EQUAL(11, readValue);
+      CHECK_EQUAL(0, replay.available());
+    }
+    if (registered() && replayedRegistration == 0)
+    {
+      replayedRegistration = millis();
+    }
+    if (replayedRegistration != 0)
+    {
+      sketch(replayedRegistration, &step);
+    }
+    XP.xloop();
+    hostAdvanceMicros(100);
+  }
+  printf("replayed %d bytes, registration after %lu ms (recorded %lu ms), %u mismatches\n", (int)data.size(),
+         replayedRegistration, registeredTime, replay.mismatches());
+  CHECK(stopped);
+  CHECK(replay.finished());
+  CHECK_EQUAL(registeredTime, replayedRegistration);
+  CHECK_EQUAL(220, readValue);
+  CHECK_EQUAL(0, replay.mismatches());
+}
+
+int main()
+{
+  replay(record());
+  remove(CAPTURE_FILE);
+  return hostTestResult();
+}
@@ -0,0 +1,81 @@
+// Traffic statistics against the plugin stand-in: bytes counted as they are on the wire in both directions,
+// in text and binary frames, and the handshake time measured again on every connect.
+#include <XPLDevices.h>
+#include "HostTest.h"
+#include "PluginStandIn.h"
+
+static HostStream link;
+static long values[4];
+
+static bool registered()
+{
+  return XP.allDataRefsRegistered() != 0;
+}
+
+static unsigned long sum(unsigned long (XPLDirect::*counter)(int))
+{
+  unsigned long total = 0;
+  for (int type = 0; type < XPL_STAT_TYPES; type++)
+  {
+    total += (XP.*counter)(type);
+  }
+  return total;
+}
+
+static void test(unsigned long offer)
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = 64;
+  XP.begin("Statistics", &link);
+  for (int i = 0; i < 4; i++)
+  {
+    XP.registerDataRef(F("sim/test/values"), XPL_READWRITE, 100, 1, &values[i], i);
+  }
+  XP.registerCommand(F("sim/test/command"));
+
+  PluginStandIn plugin(XP, link);
+  plugin.offer = offer;
+  plugin.connect();
+  unsigned long start = millis();
+  CHECK(plugin.runUntil(registered, 2000000));
+  unsigned long first = XP.handshakeTime();
+  CHECK(first > 0 && first <= millis() - start);
+
+  // traffic of all types
+  for (int i = 0; i < 4; i++)
+  {
+    plugin.updateInt(plugin.dataRefHandle("sim/test/values", i), 1000 + i);
+    values[i] = -i;
+  }
+  XP.commandTrigger(0);
+  XP.sendDebugMessage("statistics");
+  plugin.run(200000);
+  // padding and a byte of noise between frames
+  plugin.send(plugin.binary ? std::string(3, '\0') : std::string("x"));
+  plugin.updateInt(plugin.dataRefHandle("sim/test/values", 0), 7);
+  plugin.run(100000);
+  CHECK_EQUAL(7, values[0]);
+  CHECK_EQUAL(plugin.bytesToDevice, sum(&XPLDirect::rxBytes));
+  CHECK_EQUAL(plugin.bytesFromDevice, sum(&XPLDirect::txBytes));
+  CHECK(XP.rxBytes(XPL_STAT_UPDATE) > 0 && XP.txBytes(XPL_STAT_UPDATE) > 0);
+
+  // reconnect on a slower link, the handshake takes longer and is measured again
+  plugin.byteMicros = 1000;
+  plugin.connect();
+  plugin.run(10000);
+  start = millis();
+  CHECK(plugin.runUntil(registered, 5000000));
+  unsigned long second = XP.handshakeTime();
+  CHECK(second > first && second <= millis() - start + 20);
+  printf("%s: handshake %lu ms, after reconnect %lu ms\n", plugin.binary ? "binary" : "text", first, second);
+}
+
+int main()
+{
+  test(XPL_CAP_PIPELINE);
+#if XPLDIRECT_BINARY_PROTOCOL
+  test(XPL_CAP_PIPELINE | XPL_CAP_BINARY);
+#endif
+  return hostTestResult();
+}
@@ -0,0 +1,128 @@
+// Transmit path, built with and without XPLDIRECT_TX_BUFFER: padding of 64 byte writes, for the queue the
+// priority lane, draining by availableForWrite() and overflows, without queue the blocking writes counted.
+#include <XPLDevices.h>
+#include "HostTest.h"
+
+static HostStream link;
+static long value;
+static int command;
+
+static void setup(bool binary)
+{
+  hostReset();
+  link.clear();
+  link.writeSpace = -1;
+  XP.begin("Queue", &link);
+  XP.registerDataRef(F("sim/test/value"), XPL_WRITE, 0, 1, &value);
+  command = XP.registerCommand(F("sim/test/command"));
+  link.inject("<a>");
+  if (binary)
+  {
+    link.inject("<C0002>");
+  }
+  link.writeSpace = 64;
+  for (int loop = 0; loop < 10; loop++)
+  {
+    XP.xloop();
+  }
+  link.clear();
+}
+
+// sent data once the stream accepted everything
+static std::string drain(int space)
+{
+  link.writeSpace = space;
+  for (int loop = 0; loop < 100; loop++)
+  {
+    XP.xloop();
+  }
+  size_t length;
+  const char *data = link.take(&length);
+  return std::string(data, length);
+}
+
+static void testPadding()
+{
+  setup(false);
+  std::string message(61, 'x'); // "<1" message ">" is 64 bytes
+  XP.sendDebugMessage(message.c_str());
+  CHECK(drain(64) == "<1" + message + "> ");
+  CHECK_EQUAL(1, link.writeCalls64);
+
+  // a 64 byte write within a frame would need padding inside the frame, it is split differently
+  message.assign(70, 'y');
+  link.clear();
+  for (int space = 1; space <= 80; space++)
+  {
+    XP.sendDebugMessage(message.c_str());
+    CHECK(drain(space) == "<1" + message + ">");
+  }
+  CHECK_EQUAL(0, link.writeCalls64);
+
+#if XPLDIRECT_BINARY_PROTOCOL
+  setup(true);
+  message.assign(60, 'z'); // COBS code, command, handle, message and delimiter are 64 bytes
+  XP.sendDebugMessage(message.c_str());
+  std::string sent = drain(64);
+  CHECK_EQUAL(65, sent.size());
+  CHECK(sent.size() == 65 && sent[63] == 0 && sent[64] == 0); // delimiter and empty frame
+#endif
+}
+
+#if XPLDIRECT_TX_BUFFER > 0
+static void testQueue()
+{
+  setup(false);
+  link.inject("<4000sim/test/command>");
+  XP.xloop();
+
+  // nothing written without space, commands go ahead of the debug message queued before
+  link.writeSpace = 0;
+  XP.sendDebugMessage("first");
+  XP.commandTrigger(command);
+  XP.xloop();
+  CHECK_EQUAL(0, link.writeCalls);
+  CHECK(drain(3) == "<k0001><1first>");
+
+  // the queue overflows, frames are written blocking and nothing is lost
+  link.writeSpace = 0;
+  std::string expected;
+  for (int i = 0; i < 20; i++)
+  {
+    std::string message = "message " + std::to_string(i);
+    XP.sendDebugMessage(message.c_str());
+    expected += "<1" + message + ">";
+  }
+  CHECK(XP.txOverflows() > 0);
+  CHECK(drain(64) == expected);
+}
+#else
+static void testDirect()
+{
+  setup(false);
+  unsigned int overflows = XP.txOverflows();
+
+  // written directly while the stream has room
+  XP.sendDebugMessage("fits");
+  CHECK(drain(64) == "<1fits>");
+  CHECK_EQUAL(overflows, XP.txOverflows());
+
+  // a frame longer than the room of the stream blocks, it is counted and still written completely
+  link.writeSpace = 5;
+  XP.sendDebugMessage("blocking");
+  XP.sendDebugMessage("ab");
+  CHECK(drain(5) == "<1blocking><1ab>");
+  CHECK_EQUAL(overflows + 1, XP.txOverflows());
+}
+#endif
+
+int main()
+{
+  testPadding();
+#if XPLDIRECT_TX_BUFFER > 0
+  testQueue();
+#else
+  testDirect();
+#endif
+  return hostTestResult();
+}
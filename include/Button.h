@@ -34,6 +34,11 @@ public:
   /// @param input Additional mask bit. AND tied with physical input.
   void handleXP(bool input)     { _handle(input); processCommand(); };
 
+  /// @brief Check if handle() has nothing left to do until the input changes. Edge driven sketches call handle()
+  /// on a DigitalIn event of the inputs and in every loop after it until idle() is true.
+  /// @return true: debounce settled, state matches the inputs
+  bool idle();
+
   /// @brief Evaluate and reset transition if button pressed down
   /// @return true: Button was pressed. Transition detected.
   bool pressed()                { return _transition == transPressed  ? (_transition = transNone, true) : false; };
@@ -109,6 +114,11 @@ public:
   /// @param input Additional mask bit. AND tied with physical input.
   void handleXP(bool input)     { _handle(input); processCommand(); };
 
+  /// @brief Check if handle() has nothing left to do until the input changes. A held button with repeat
+  /// function is never idle.
+  /// @return true: debounce settled, state matches the input
+  bool idle();
+
 protected:
   uint32_t _delay;
   uint32_t _timer;
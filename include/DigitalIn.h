@@ -7,6 +7,25 @@
 #define MUX_MAX_NUMBER 6
 #endif
 
+/// @brief Wait time in us after changing the mux adress before the inputs are read. Depends on board speed and wiring.
+#ifndef MUX_SETTLE_TIME
+#ifdef ARDUINO_ARCH_AVR
+#define MUX_SETTLE_TIME 1
+#else
+#define MUX_SETTLE_TIME 0 // digitalWrite() is slow enough
+#endif
+#endif
+
+/// @brief Allow scanning the mux in the background with tick() called from a timer interrupt
+#ifndef MUX_BACKGROUND_SCAN
+#define MUX_BACKGROUND_SCAN 0
+#endif
+
+/// @brief Size of the input event queue, 0 to disable. Change masks are always available.
+#ifndef MUX_EVENT_QUEUE
+#define MUX_EVENT_QUEUE 0
+#endif
+
 /// @brief Maximum number of MCP23017 multiplexers
 #ifndef MCP_MAX_NUMBER
 #define MCP_MAX_NUMBER 0
@@ -19,6 +38,15 @@
 
 #define NOT_USED 255
 
+/// @brief Input change as reported by DigitalIn.nextEvent()
+struct DigitalInEvent_t
+{
+  uint8_t expander;   // expander number (from DigitalIn initialization order)
+  uint8_t channel;    // channel on the expander (0-15)
+  bool engaged;       // new status of the input (true = GND)
+  unsigned long time; // millis() of the handle() call that detected the change
+};
+
 /// @brief Class to encapsulate digital inputs from 74HC4067 and MCP23017 input multiplexers,
 /// used by all digital input devices. Scans all expander inputs into internal process data image.
 class DigitalIn_
@@ -42,8 +70,10 @@ public:
 #if MCP_MAX_NUMBER > 0
   /// @brief Add one MCP23017 i2c multiplexer
   /// @param adress i2c adress of the multiplexer (valid: 0x20-0x28)
+  /// @param intPin Arduino pin connected to INTA or INTB (mirrored, open drain, may be shared by several MCP).
+  /// The MCP is only read when the pin signals a change. NOT_USED: read every handle().
   /// @return true when successful, false when all mux have been used up (increase MCP_MAX_NUMBER)
-  bool addMCP(uint8_t adress);
+  bool addMCP(uint8_t adress, uint8_t intPin = NOT_USED);
 #endif
   
   /// @brief Get one bit from the mux or a digital input
@@ -52,20 +82,79 @@ public:
   /// @return Status of the input (inverted, true = GND, false = +5V)
   bool getBit(uint8_t expander, uint8_t channel);
   
-  /// @brief Read all mux inputs into process data input image
+  /// @brief Read all mux inputs into process data input image.
+  /// With background scan, take over the last complete scan instead. The interrupt state is kept on AVR and
+  /// ARM Cortex-M, on other boards interrupts are enabled afterwards.
   void handle();
+
+  /// @brief Get the inputs of one expander that changed in the last handle()
+  /// @param expander Expander (mux or mcp)
+  /// @return One bit per channel, set when the input changed
+  int16_t getChanges(uint8_t expander);
+
+  /// @brief Check if any input of any expander changed in the last handle()
+  /// @return true when at least one input changed
+  bool anyChanges() { return _anyChanges; };
+
+#if MUX_EVENT_QUEUE > 0
+  /// @brief Get the oldest input change from the event queue. All inputs are released before the first handle(),
+  /// so inputs that are engaged at startup are reported once. Devices can be driven by the events: handle() a device
+  /// on an event of its inputs and in every loop after it until its idle() is true.
+  /// @param event Receives the change
+  /// @return true when an event was returned, false when the queue is empty
+  bool nextEvent(DigitalInEvent_t *event);
+
+  /// @brief Number of events lost because the queue was full (increase MUX_EVENT_QUEUE)
+  unsigned int eventsDropped() { return _eventsDropped; };
+#endif
+
+#if MUX_BACKGROUND_SCAN
+  /// @brief Switch between scanning in handle() and in tick()
+  /// @param enable true: mux are scanned by tick(), false: by handle()
+  /// The interrupt state is kept on AVR and ARM Cortex-M, on other boards interrupts are enabled afterwards.
+  void setBackgroundScan(bool enable);
+
+  /// @brief Read one mux channel and set the adress of the next one. Call from a timer interrupt,
+  /// the tick period is the settle time of the mux. A complete scan takes 16 ticks.
+  void tick();
+#endif
 private:
+  void _setAddress(uint8_t channel);
+  void _detectChanges();
   uint8_t _s0, _s1, _s2, _s3;
+  uint8_t _channel; // current mux adress, > 15 when unknown
+#if MUX_BACKGROUND_SCAN
+  volatile bool _background;
+  uint8_t _scanStep;
+  int16_t _scanBack[MUX_MAX_NUMBER];           // scan in progress, written by tick()
+  volatile int16_t _scanFront[MUX_MAX_NUMBER]; // last complete scan, taken over by handle()
+#endif
 #ifdef ARDUINO_ARCH_AVR
   uint8_t _s0port, _s1port, _s2port, _s3port;
   uint8_t _s0mask, _s1mask, _s2mask, _s3mask;
+  volatile uint8_t *_addrPort; // output register when all adress pins are on one port, else NULL
+  uint8_t _addrMask;
+  uint8_t _numPorts;
+  volatile uint8_t *_portInput[MUX_MAX_NUMBER]; // input registers of ports with mux data pins, each read once per channel
+  uint8_t _muxPort[MUX_MAX_NUMBER + MCP_MAX_NUMBER]; // port index of each mux
+  uint8_t _muxBit[MUX_MAX_NUMBER + MCP_MAX_NUMBER];  // bit of the data pin on its port
 #endif
   uint8_t _numPins;
   uint8_t _pin[MUX_MAX_NUMBER + MCP_MAX_NUMBER];
   int16_t _data[MUX_MAX_NUMBER + MCP_MAX_NUMBER];
+  int16_t _previous[MUX_MAX_NUMBER + MCP_MAX_NUMBER]; // input image of the previous handle()
+  int16_t _changes[MUX_MAX_NUMBER + MCP_MAX_NUMBER];  // changed inputs in the last handle()
+  bool _anyChanges;
+#if MUX_EVENT_QUEUE > 0
+  DigitalInEvent_t _event[MUX_EVENT_QUEUE];
+  uint8_t _eventFirst;
+  uint8_t _eventCount;
+  unsigned int _eventsDropped;
+#endif
 #if MCP_MAX_NUMBER > 0
   uint8_t _numMCP;
   Adafruit_MCP23X17 _mcp[MCP_MAX_NUMBER];
+  uint8_t _mcpInt[MCP_MAX_NUMBER]; // interrupt pin of each MCP or NOT_USED
 #endif
 };
 
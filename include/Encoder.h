@@ -43,6 +43,12 @@ public:
   /// @brief Handle realtime and process XPLDirect commands.
   void handleXP()   { handle(); processCommand(); };
 
+  /// @brief Check if handle() has nothing left to do until an input changes. Edge driven sketches call handle()
+  /// on a DigitalIn event of the inputs and in every loop after it until idle() is true.
+  /// @return true: debounce settled, state matches the inputs
+  bool idle();
+
+
   /// @brief Read current Encoder count.
   /// @return Remaining Encoder count.
   int16_t pos()     { return _count; };
@@ -0,0 +1,117 @@
+#ifndef Profiler_h
+#define Profiler_h
+#include <Arduino.h>
+#include <XPLDirect.h>
+
+/// @brief Enable loop time instrumentation. With 0 all probes compile to nothing.
+#ifndef XPL_PROFILE
+#define XPL_PROFILE 0
+#endif
+
+/// @brief Maximum number of named probes
+#ifndef PROFILE_MAX_PROBES
+#define PROFILE_MAX_PROBES 8
+#endif
+
+/// @brief Number of buckets of the loop period histogram, the last one collects all longer periods
+#ifndef PROFILE_BUCKETS
+#define PROFILE_BUCKETS 8
+#endif
+
+/// @brief Width of one histogram bucket in us
+#ifndef PROFILE_BUCKET_US
+#define PROFILE_BUCKET_US 500
+#endif
+
+#if XPL_PROFILE
+
+#if XPL_USE_PROGMEM
+#define XPL_PROFILE_NAME(name) F(name)
+#else
+#define XPL_PROFILE_NAME(name) name
+#endif
+
+/// @brief Measure the time spent in the enclosing scope under the given name
+#define XPL_PROFILE_SCOPE(name)                                             \
+  static int8_t _profileProbe = Profiler.addProbe(XPL_PROFILE_NAME(name)); \
+  ProfileScope _profileScope(_profileProbe)
+
+/// @brief Record the loop period, call once per loop
+#define XPL_PROFILE_LOOP() Profiler.loop()
+
+/// @brief Send all statistics with sendDebugMessage and restart measurement
+#define XPL_PROFILE_REPORT() Profiler.report()
+
+/// @brief Collects run time statistics of named probes and a histogram of the loop period.
+/// Use the XPL_PROFILE_xxx macros, so the instrumentation disappears when XPL_PROFILE is 0.
+class Profiler_
+{
+public:
+  /// @brief Class constructor
+  Profiler_();
+
+  /// @brief Add a named probe
+  /// @param name Name of the probe, use F() macro
+  /// @return Probe number, -1 when all probes are used up (increase PROFILE_MAX_PROBES)
+  int8_t addProbe(XPString_t *name);
+
+  /// @brief Add one measurement to a probe
+  /// @param probe Probe number from addProbe()
+  /// @param time Measured time in us
+  void record(int8_t probe, unsigned long time);
+
+  /// @brief Record the time since the last call as loop period
+  void loop();
+
+  /// @brief Send min/max/mean of all probes and the loop histogram with sendDebugMessage and reset them
+  void report();
+
+  /// @brief Reset all statistics
+  void reset();
+
+private:
+  struct Stat_t
+  {
+    unsigned long min;
+    unsigned long max;
+    unsigned long sum;
+    unsigned long count;
+  };
+  void _clear(Stat_t *stat);
+  void _add(Stat_t *stat, unsigned long time);
+  void _send(XPString_t *name, Stat_t *stat);
+  XPString_t *_name[PROFILE_MAX_PROBES];
+  Stat_t _probe[PROFILE_MAX_PROBES];
+  int8_t _numProbes;
+  Stat_t _loop;
+  unsigned long _lastLoop;
+  unsigned int _histogram[PROFILE_BUCKETS];
+};
+
+extern Profiler_ Profiler;
+
+/// @brief Measures the lifetime of the object, used by XPL_PROFILE_SCOPE
+class ProfileScope
+{
+public:
+  ProfileScope(int8_t probe)
+  {
+    _probe = probe;
+    _start = micros();
+  }
+  ~ProfileScope() { Profiler.record(_probe, micros() - _start); }
+
+private:
+  int8_t _probe;
+  unsigned long _start;
+};
+
+#else
+
+#define XPL_PROFILE_SCOPE(name)
+#define XPL_PROFILE_LOOP()
+#define XPL_PROFILE_REPORT()
+
+#endif
+
+#endif
@@ -22,6 +22,12 @@ public:
   /// @brief Handle realtime and process XPLDirect commands
   void handleXP() { handle(); processCommand(); };
 
+  /// @brief Check if handle() has nothing left to do until an input changes. Edge driven sketches call handle()
+  /// on a DigitalIn event of the inputs and in every loop after it until idle() is true.
+  /// @return true: debounce settled, state matches the inputs
+  bool idle();
+
+
   /// @brief Check whether Switch set to on
   /// @return true: Switch is on
   bool on()       { return _state == switchOn; };
@@ -97,6 +103,12 @@ public:
   /// @brief Handle realtime and process XPLDirect commands
   void handleXP() { handle(); processCommand(); };
 
+  /// @brief Check if handle() has nothing left to do until an input changes. Edge driven sketches call handle()
+  /// on a DigitalIn event of the inputs and in every loop after it until idle() is true.
+  /// @return true: debounce settled, state matches the inputs
+  bool idle();
+
+
   /// @brief Check whether Switch set to off
   /// @return true: Switch is off
   bool off()      { return _state == switchOff; };
@@ -0,0 +1,118 @@
+#ifndef XPLCapture_h
+#define XPLCapture_h
+#include <Arduino.h>
+
+/// @brief Size of the capture ring buffer in bytes, the oldest records are dropped when full
+#ifndef XPLCAPTURE_BUFFER
+#define XPLCAPTURE_BUFFER 256
+#endif
+
+// Capture record: header byte (bit 7 set for TX, bits 0-6 number of data bytes), ms since previous
+// record as 16 bit little endian (saturated), data bytes. Bytes of one direction within the same ms
+// are merged into one record.
+#define XPLCAPTURE_TX 0x80
+#define XPLCAPTURE_MAXLENGTH 0x7F
+#define XPLCAPTURE_HEADER 3
+
+/// @brief Stream decorator recording all traffic of the wrapped stream with timestamps into a ring buffer.
+/// Pass it to XP.begin() instead of the serial port, the recorded data can be dumped with dump().
+class XPLCapture : public Stream
+{
+public:
+  /// @brief Constructor
+  /// @param device Stream to wrap, usually Serial
+  XPLCapture(Stream *device);
+
+  /// @brief Write the capture oldest first and clear it. Recording goes on, consecutive dumps
+  /// add up to one capture.
+  /// @param out Destination, e.g. a second serial port or a file
+  /// @return Number of bytes written
+  int dump(Print *out);
+
+  /// @brief Copy the capture oldest first into a buffer and clear it, like dump(Print *)
+  /// @param buffer Destination
+  /// @param size Size of the destination, capture is truncated at a record boundary
+  /// @return Number of bytes copied
+  int dump(byte *buffer, int size);
+
+  /// @brief Number of bytes in the capture
+  int size() { return _used; }
+
+  /// @brief Number of records dropped because the buffer was full
+  unsigned int dropped() { return _dropped; }
+
+  /// @brief Discard the capture
+  void clear();
+
+  // Stream interface
+  int available();
+  int read();
+  int peek();
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *buffer, size_t size);
+  int availableForWrite();
+  void flush();
+  using Print::write;
+
+private:
+  void _record(byte direction, const uint8_t *data, int length);
+  void _empty();
+  void _put(byte data);
+  byte _at(int pos);
+  void _dropOldest();
+  Stream *_device;
+  byte _buffer[XPLCAPTURE_BUFFER];
+  int _head;
+  int _tail;
+  int _used;
+  int _open;  // position of the header of the record data is appended to, -1 if none
+  unsigned long _lastTime;
+  unsigned int _dropped;
+};
+
+/// @brief Stream replaying the received data of a capture with the recorded timing, based on millis().
+/// Pass it to XP.begin() to feed a recorded session into XPLDirect. Sent data is compared
+/// with the recorded sent data.
+class XPLReplay : public Stream
+{
+public:
+  /// @brief Constructor
+  /// @param capture Capture as written by XPLCapture::dump()
+  /// @param length Length of the capture
+  XPLReplay(const byte *capture, int length);
+
+  /// @brief Restart replay, now corresponds to the start (or last clear) of the capture
+  void restart();
+
+  /// @brief True when all received data has been replayed
+  bool finished() { return _rx.pos >= _length; }
+
+  /// @brief Number of sent bytes that differed from the capture
+  unsigned int mismatches() { return _mismatches; }
+
+  // Stream interface
+  int available();
+  int read();
+  int peek();
+  size_t write(uint8_t data);
+  int availableForWrite() { return 64; }
+  void flush() {}
+  using Print::write;
+
+private:
+  struct Cursor_t
+  {
+    int pos;            // header of the current record
+    int remaining;      // data bytes left in the current record
+    unsigned long time; // ms of the current record since start of capture
+  };
+  void _seek(Cursor_t *cursor, byte direction);
+  const byte *_capture;
+  int _length;
+  Cursor_t _rx;
+  Cursor_t _tx;
+  unsigned long _start;
+  unsigned int _mismatches;
+};
+
+#endif
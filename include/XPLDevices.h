@@ -10,5 +10,7 @@
 #include <Timer.h>
 #include <DigitalIn.h>
 #include <AnalogIn.h>
+#include <Profiler.h>
+#include <XPLCapture.h>
 
 #endif
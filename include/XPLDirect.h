@@ -9,15 +9,24 @@
 #define XPLDirect_h
 #include <Arduino.h>
 
+// Datarefs and commands live in static pools, change the limits to suit your needs and the RAM of your board.
+// RAM per entry: AVR 42 bytes per dataref and 7 per command, 32 bit boards about 56 and 16 bytes. With the default
+// of 100 the pools take 4.9 KB on AVR, boards with less RAM fail at link time until the limits are lowered.
+// Registrations beyond a limit return -1, are counted in registrationsDropped() and reported to the plugin log
+// on every connect.
 #ifndef XPLDIRECT_MAXDATAREFS_ARDUINO
-#define XPLDIRECT_MAXDATAREFS_ARDUINO 100 // This can be changed to suit your needs and capabilities of your board.
+#define XPLDIRECT_MAXDATAREFS_ARDUINO 100
 #endif
 
 #ifndef XPLDIRECT_MAXCOMMANDS_ARDUINO
-#define XPLDIRECT_MAXCOMMANDS_ARDUINO 100  // Same here.
+#define XPLDIRECT_MAXCOMMANDS_ARDUINO 100
 #endif
 
-#define XPLDIRECT_RX_TIMEOUT 500 // after detecting a frame header, how long will we wait to receive the rest of the frame.  (default 500)
+#ifndef XPLDIRECT_MAXHANDLES
+#define XPLDIRECT_MAXHANDLES XPLDIRECT_MAXDATAREFS_ARDUINO // size of the handle lookup table for incoming updates, larger handles fall back to a linear search
+#endif
+
+#define XPLDIRECT_RX_TIMEOUT 500 // after detecting a frame header, how long will we wait for the rest of the frame before dropping it.  (default 500)
 
 #ifndef XPLMAX_PACKETSIZE
 #define XPLMAX_PACKETSIZE 80  // Probably leave this alone. If you need a few extra bytes of RAM it could be reduced, but it needs to
@@ -25,6 +34,32 @@
                               // that transfer strings it needs to be big enough for those too. (default 200)
 #endif
 
+#ifndef XPLDIRECT_REGISTER_WINDOW
+#define XPLDIRECT_REGISTER_WINDOW 8 // number of registrations sent per request poll to plugins supporting pipelining, 1 disables pipelining
+#endif
+
+#ifndef XPLDIRECT_REGISTER_RETRY
+#define XPLDIRECT_REGISTER_RETRY 3  // request polls to wait for outstanding registration responses before sending them again
+#endif
+
+#ifndef XPLDIRECT_TX_BUFFER
+#define XPLDIRECT_TX_BUFFER 0 // size of a transmit queue drained by xloop() as far as the stream accepts without blocking, e.g. 128.
+                              // Needs a stream implementing availableForWrite(), streams reporting 0 only get written when the queue is full.
+                              // 0 writes directly.
+#endif
+
+#ifndef XPLDIRECT_TX_PRIORITY_BUFFER
+#define XPLDIRECT_TX_PRIORITY_BUFFER 32 // separate queue for command frames, sent ahead of dataref updates
+#endif
+
+#ifndef XPLDIRECT_BINARY_PROTOCOL
+#define XPLDIRECT_BINARY_PROTOCOL 0 // offer compact binary framing to plugins supporting it, costs some flash
+#endif
+
+#ifndef XPLDIRECT_STATISTICS
+#define XPLDIRECT_STATISTICS 1 // count frames and bytes per direction and traffic type, costs 80 bytes RAM
+#endif
+
 #ifndef XPL_USE_PROGMEM
 #define XPL_USE_PROGMEM 1
 #endif
@@ -33,7 +68,7 @@
 // STOP! Dont change any other defines in this header!
 //////////////////////////////////////////////////////////////
 
-#ifdef XPL_USE_PROGMEM
+#if XPL_USE_PROGMEM
 // use Flash for strings, requires F() macro for strings in all registration calls
   typedef const __FlashStringHelper XPString_t;
 #else
@@ -69,6 +104,37 @@
 #define XPLCMD_COMMANDTRIGGER 'k' //  %3.3i%3.3i   command handle, number of triggers
 #define XPLCMD_SENDVERSION 'v'    // we will respond with current build version
 #define XPL_EXITING 'x'           // MG 03/14/2023: xplane sends this to the arduino device during normal shutdown of xplane.  It may not happen if xplane crashes.
+#define XPLCMD_CAPABILITIES 'C'   // %3.3i%ld   0, bitmask of protocol extensions. Sent by plugins knowing the extensions after XPLRESPONSE_VERSION, answered with the accepted subset
+#define XPLCMD_DATAREFUPDATEMULTI 'M' // (%3.3i%s;)*  list of dataref handle, value and separator (XPL_CAP_MULTIUPDATE only)
+#define XPLREQUEST_REGISTERARRAY 'n'  // %1.1i%2.2i%2.2i%5.5i%s RWMode, first array index, number of elements, divider, dataref name (XPL_CAP_ARRAYBLOCK only)
+#define XPLCMD_DATAREFUPDATEARRAY 'N' // %3.3i%2.2i(%s;)*  array block handle, offset of first value in block, list of values and separator (XPL_CAP_ARRAYBLOCK only)
+#define XPLREQUEST_STATISTICS 'Q'     // %3.3i   traffic type, or XPL_STAT_TYPES for the error counters
+#define XPLRESPONSE_STATISTICS 'q'    // %3.3i(%lu;)*  traffic type, rx frames, rx bytes, tx frames, tx bytes
+                                      // for XPL_STAT_TYPES: malformed, oversize and dropped rx frames, tx overflows, handshake time in ms
+#define XPLDIRECT_UPDATESEPARATOR ';'
+
+// Protocol extensions, only used when accepted with XPLCMD_CAPABILITIES. Legacy plugins never send it and get the plain protocol.
+#define XPL_CAP_PIPELINE 0x01     // plugin accepts multiple registration requests per XPLCMD_SENDREQUEST
+#define XPL_CAP_BINARY 0x02       // both sides switch to binary frames after the capability answer:
+                                  // COBS encoded, 0x00 delimited, command byte, handle as varint (0 if unused), payload.
+                                  // Payload: int32 / IEEE754 float little endian, raw string bytes or for XPLREQUEST_REGISTERDATAREF
+                                  // RWMode byte, array index byte, divider as float and the dataref name.
+#define XPL_CAP_MULTIUPDATE 0x04  // plugin accepts XPLCMD_DATAREFUPDATEMULTI, all updates of one xloop() are packed into as few frames as possible.
+                                  // Binary payload is a list of handle varint and value.
+#define XPL_CAP_ARRAYBLOCK 0x08   // plugin accepts XPLREQUEST_REGISTERARRAY and sends array blocks with XPLCMD_DATAREFUPDATEARRAY.
+                                  // Binary payload is the offset byte and the values. Without it block elements are registered one by one.
+
+#if XPLDIRECT_REGISTER_WINDOW > 1
+#define XPLDIRECT_CAP_PIPELINE XPL_CAP_PIPELINE
+#else
+#define XPLDIRECT_CAP_PIPELINE 0
+#endif
+#if XPLDIRECT_BINARY_PROTOCOL
+#define XPLDIRECT_CAP_BINARY XPL_CAP_BINARY
+#else
+#define XPLDIRECT_CAP_BINARY 0
+#endif
+#define XPLDIRECT_CAPABILITIES (XPLDIRECT_CAP_PIPELINE | XPLDIRECT_CAP_BINARY | XPL_CAP_MULTIUPDATE | XPL_CAP_ARRAYBLOCK)
 
 #define XPL_READ 1
 #define XPL_WRITE 2
@@ -78,11 +144,24 @@
 #define XPL_DATATYPE_FLOAT 2
 #define XPL_DATATYPE_STRING 3
 
+// traffic types for statistics
+#define XPL_STAT_CONTROL 0  // connection, version and capability handling
+#define XPL_STAT_REGISTER 1 // registration requests and responses
+#define XPL_STAT_UPDATE 2   // dataref updates
+#define XPL_STAT_COMMAND 3  // command start, end and trigger
+#define XPL_STAT_MESSAGE 4  // debug and speak messages
+#define XPL_STAT_TYPES 5
+
+#define XPL_FLOAT_DECIMALS 6 // maximum decimals sent for float datarefs
+
+typedef void (*XPLDataRefCallback)(int handle); // called when xplane updated a dataref
+
 class XPLDirect
 {
 public:
   XPLDirect(Stream*);
   void begin(const char *devicename); // parameter is name of your device for reference
+  void begin(const char *devicename, Stream *device); // same, but use another stream than given in the constructor, e.g. XPLCapture
   int connectionStatus(void);
   int commandTrigger(int commandHandle);                    // triggers specified command 1 time;
   int commandTrigger(int commandHandle, int triggerCount);  // triggers specified command triggerCount times.  
@@ -90,63 +169,211 @@ public:
   int commandEnd(int commandHandle);
   int datarefsUpdated();      // returns true if xplane has updated any datarefs since last call to datarefsUpdated()
   int hasUpdated(int handle); // returns true if xplane has updated this dataref since last call to hasUpdated()
+  int nextChanged(int handle); // iterate datarefs updated by xplane in the last xloop(), start with -1, returns -1 at the end
+  int setCallback(int handle, XPLDataRefCallback callback); // called from xloop() on every update of this dataref, NULL to remove
+  int markDirty(int handle);  // tell that a written dataref has changed. Once used for a dataref it is only checked after markDirty(), idle datarefs cost nothing.
+  int setDeadband(int handle, float absolute, float relative); // float datarefs only: changes within max(absolute, relative * last sent value) are not sent
   int registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, long int *value);
   int registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, long int *value, int index);
   int registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, float *value);
   int registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, float *value, int index);
   int registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, char* value);
+  // array block: elements index to index + count - 1 into value[0..count-1], XPL_READ only, up to element 99. Returns handle of the first element, the others follow.
+  int registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, long int *value, int index, int count);
+  int registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, float *value, int index, int count);
   int registerCommand(XPString_t *commandName); 
   int sendDebugMessage(const char *msg);
   int sendSpeakMessage(const char* msg);
   int allDataRefsRegistered(void);
+  unsigned int registrationsDropped(void); // datarefs and commands not registered because their pool was full
+  unsigned int rxMalformedFrames(void); // number of received frames dropped because they were empty or incomplete
+  unsigned int rxOversizeFrames(void);  // number of received frames dropped because they exceeded XPLMAX_PACKETSIZE
+  unsigned int txOverflows(void);       // frames written blocking: the transmit queue was full or, without queue, the stream had no room
+  unsigned int rxDroppedFrames(void);   // number of dataref updates received for unknown handles or outside an array block
+  unsigned long handshakeTime(void);    // ms from name request to completed registration of the last connect
+#if XPLDIRECT_STATISTICS
+  unsigned long rxFrames(int type);     // frames received of XPL_STAT_xxx type
+  unsigned long rxBytes(int type);      // bytes as read from the stream, bytes between frames count for the next frame
+  unsigned long txFrames(int type);     // frames sent of XPL_STAT_xxx type
+  unsigned long txBytes(int type);
+  void resetStatistics(void);
+#endif
   void sendResetRequest(void);
   int xloop(void); // where the magic happens!
 private:
   void _processSerial();
   void _processPacket();
   void _sendPacketInt(int command, int handle, long int value); // for ints
-  void _sendPacketFloat(int command, int handle, float value);  // for floats
+  void _sendPacketFloat(int command, int handle, float value, byte decimals); // for floats
   void _sendPacketVoid(int command, int handle);                // just a command with a handle
   void _sendPacketString(int command, char *str);               // for a string
-  void _transmitPacket();
+  bool _sendDataRef(int i);
+  void _scheduleDataRef(int i, unsigned long now);
+  void _rebuildSchedule();
+  bool _heapBefore(int a, int b);
+  void _heapSwap(int a, int b);
+  void _heapPush(int i);
+  int _heapPop();
+  void _sendUpdate(int handle, long int value);
+  void _sendUpdate(int handle, float value, byte decimals);
+  void _appendUpdate(int handle, const void *data, int length);
+  void _flushUpdates();
+  void _sendRegisterDataRef(int i);
+  void _sendRegisterCommand(int i);
+  void _clearRegisterPending();
+  bool _namePending(int i);
+  bool _nameEquals(XPString_t *a, XPString_t *b);
+  void _frameBegin(char command);
+  void _frameAppend(char c);
+  void _frameAppend(const char *data, int length);
+  void _frameDigits(int value, byte digits);
+  void _frameNumber(long int value);
+  void _frameName(XPString_t *name);
+  void _transmitPacket(); // completes and sends the frame in _sendBuffer
+  bool _isPriority(char command);
+  void _queueFrame(const char *frame, int length, bool priority);
+  void _streamWrite(const byte *data, int length);
+#if XPLDIRECT_BINARY_PROTOCOL
+  void _receiveBinary(char c);
+  int _cobsDecode(byte *buffer, int length);
+  int _cobsEncode(byte *buffer, int length);
+  int _varintDecode(const byte *buffer, int length, int *value);
+  void _binaryBegin(int command, int handle);
+  void _binaryAppendVarint(int value);
+  void _binaryAppend(const void *data, int length);
+  void _binaryAppendName(XPString_t *name);
+  void _transmitBinary();
+  int _binaryHandle;
+#endif
   void _sendname();
   void _sendVersion();
+  void _clearHandleMap();
+  void _dataRefReceived(int i);
+  int _addDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, void *value, byte type, int index);
+  int _addDataRefBlock(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, void *value, byte type, int index, int count);
+  bool _isBlockElement(int i);
+  void _receiveArrayBlock(int i);
+  int _findDataRef(int handle);
+  unsigned int _nameHash(XPString_t *name);
+  unsigned int _frameNameHash();
+  bool _frameNameMatches(XPString_t *name);
+  char _nameChar(XPString_t *name, int n);
   int _getHandleFromFrame();
   int _getPayloadFromFrame(long int *);
   int _getPayloadFromFrame(float *);
   int _getPayloadFromFrame(char *);
+  byte _dividerDecimals(float divider);
+  int _formatFloat(char *buffer, float value, byte decimals);
+  float _parseFloat(const char *str);
 
   Stream *streamPtr;
   char *_deviceName;
   char _receiveBuffer[XPLMAX_PACKETSIZE];
   int _receiveBufferBytesReceived;
+  enum
+  {
+    XPL_RX_IDLE,    // waiting for packet header
+    XPL_RX_FRAME,   // collecting frame until packet trailer
+    XPL_RX_DISCARD  // skipping rest of an oversized frame
+  } _receiveState;
+  unsigned long _lastReceiveTime;
+  unsigned int _rxMalformedFrames;
+  unsigned int _rxOversizeFrames;
   char _sendBuffer[XPLMAX_PACKETSIZE];
+  int _sendBufferLength;
+  int _multiUpdateCount;
+  unsigned int _txOverflows;
+  unsigned int _rxDroppedFrames;
+  unsigned long _handshakeStart;
+  unsigned long _handshakeTime;
+#if XPLDIRECT_STATISTICS
+  struct _trafficStructure
+  {
+    unsigned long frames;
+    unsigned long bytes;
+  } _rxTraffic[XPL_STAT_TYPES], _txTraffic[XPL_STAT_TYPES];
+  unsigned int _rxWireBytes; // bytes read since the last frame was processed
+  byte _trafficType(char command);
+#endif
+  void _sendStatistics(int type);
+  void _sendPoolWarning();
+  unsigned int _registrationsDropped;
+#if XPLDIRECT_TX_BUFFER > 0
+  struct _txLaneStructure
+  {
+    byte *buffer; // frames stored as length byte and data
+    unsigned int size;
+    unsigned int head;
+    unsigned int tail;
+    unsigned int used;
+  } _txNormalLane, _txPriorityLane, *_txLane;
+  byte _txNormalBuffer[XPLDIRECT_TX_BUFFER];
+  byte _txPriorityBuffer[XPLDIRECT_TX_PRIORITY_BUFFER];
+  int _txFrameRemaining; // bytes of the current frame still to be written from _txLane
+  void _txPush(_txLaneStructure *lane, byte data);
+  byte _txPop(_txLaneStructure *lane);
+  void _drainTx(bool all);
+#endif
   int _connectionStatus;
+#if XPLDIRECT_MAXDATAREFS_ARDUINO < 255
+  typedef byte _indexType; // save RAM on small boards
+#define XPL_NO_INDEX 255
+#else
+  typedef int _indexType;
+#define XPL_NO_INDEX -1
+#endif
   int _dataRefsCount;
-  struct _dataRefStructure
+  struct _dataRefStructure // data used in every loop
   {
     int dataRefHandle;
-    byte dataRefRWType;       // XPL_READ, XPL_WRITE, XPL_READWRITE
-    byte dataRefVARType;      // XPL_DATATYPE_INT 1, XPL_DATATYPE_FLOAT  2   XPL_DATATYPE_STRING 3
+    byte dataRefVARType : 2;  // XPL_DATATYPE_INT 1, XPL_DATATYPE_FLOAT  2   XPL_DATATYPE_STRING 3
+    byte decimals : 3;        // digits after decimal point needed for divider
+    byte forceUpdate : 1;     // in case xplane plugin asks for a refresh
+    byte updatedFlag : 1;     //  True if xplane has updated this dataref.  Gets reset when we call hasUpdated method.
+    byte queued : 1;          // in the update schedule
+    byte dirty : 1;           // marked as changed with markDirty()
+    byte explicitDirty : 1;   // only checked when marked with markDirty()
     float divider;            // tell the host to reduce resolution by dividing then remultiplying by this number to reduce traffic.   (ie .02, .1, 1, 5, 10, 100, 1000 etc)
-    byte forceUpdate;         // in case xplane plugin asks for a refresh
-    unsigned long updateRate; // maximum update rate in milliseconds, 0 = every change
-    unsigned long lastUpdateTime;
-    XPString_t *dataRefName;
+    float deadband;           // absolute change needed before a float is sent again
+    float deadbandRelative;   // change needed relative to the last sent value
+    unsigned int updateRate;  // maximum update rate in milliseconds, 0 = every change
+    unsigned long nextUpdateTime; // scheduled time for next check in xloop(), not before the rate limit passed
     void *latestValue;
     union {
       long int lastSentIntValue;
       float lastSentFloatValue;
     };
-    byte updatedFlag; //  True if xplane has updated this dataref.  Gets reset when we call hasUpdated method.
-    byte arrayIndex;  // for datarefs that speak in arrays
-  } *_dataRefs[XPLDIRECT_MAXDATAREFS_ARDUINO];
+  } _dataRefs[XPLDIRECT_MAXDATAREFS_ARDUINO]; // static pool, RAM use is visible at link time
+  struct _dataRefInfoStructure // data used for registration only
+  {
+    XPString_t *dataRefName;
+    unsigned int nameHash;    // hash of dataRefName to speed up registration
+    byte dataRefRWType;       // XPL_READ, XPL_WRITE, XPL_READWRITE
+    byte arrayIndex;          // for datarefs that speak in arrays
+    byte arrayCount;          // elements of an array block starting here, 0 for the following elements, 1 for single datarefs
+    byte registerPending;     // registration request sent, waiting for handle from xplane
+    XPLDataRefCallback callback;
+  } _dataRefInfo[XPLDIRECT_MAXDATAREFS_ARDUINO];
+  _indexType _writeRefs[XPLDIRECT_MAXDATAREFS_ARDUINO]; // datarefs sent to xplane
+  int _writeRefsCount;
+  _indexType _readRefs[XPLDIRECT_MAXDATAREFS_ARDUINO];  // datarefs received from xplane
+  int _readRefsCount;
   int _commandsCount;
   struct _commandStructure
   {
     int commandHandle;
     XPString_t *commandName;
-  } *_commands[XPLDIRECT_MAXCOMMANDS_ARDUINO];
+    unsigned int nameHash;
+    byte registerPending;
+  } _commands[XPLDIRECT_MAXCOMMANDS_ARDUINO];
+  _indexType _handleMap[XPLDIRECT_MAXHANDLES]; // maps handles assigned by xplane to local dataref index
+  _indexType _dueHeap[XPLDIRECT_MAXDATAREFS_ARDUINO]; // writable datarefs ordered by nextUpdateTime
+  int _dueCount;
+  byte _changedSet[(XPLDIRECT_MAXDATAREFS_ARDUINO + 7) / 8]; // datarefs updated by xplane in the last xloop()
+  byte _changedAny;
+  long int _capabilities;      // protocol extensions accepted from plugin
+  byte _binaryMode;            // binary framing negotiated with XPL_CAP_BINARY
+  byte _registerPolls;         // request polls without response to pipelined registrations
   byte _allDataRefsRegistered; // becomes true if all datarefs have been registered
   byte _datarefsUpdatedFlag;   // becomes true if any datarefs have been updated from xplane since last call to datarefsUpdated()
 };
@@ -39,6 +39,11 @@ void Button::_handle(bool input)
   }
 }
 
+bool Button::idle()
+{
+  return DigitalIn.getBit(_mux, _pin) ? _state == DEBOUNCE_DELAY : _state == 0;
+}
+
 void Button::setCommand(int cmdPush)
 {
   _cmdPush = cmdPush;
@@ -91,4 +96,9 @@ void RepeatButton::_handle(bool input)
       _transition = transReleased;
     }
   }
-}
\ No newline at end of file
+}
+
+bool RepeatButton::idle()
+{ // held down, the repeat timer needs handle()
+  return DigitalIn.getBit(_mux, _pin) ? _state == DEBOUNCE_DELAY && _delay == 0 : _state == 0;
+}
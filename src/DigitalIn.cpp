@@ -1,20 +1,46 @@
 #include <Arduino.h>
 #include "DigitalIn.h"
+#include "Profiler.h"
 
 #define MCP_PIN 254
 
+// MCP23017 registers (IOCON.BANK = 0, A/B pairs interleaved)
+#define MCP_IODIRA 0x00
+#define MCP_IOCON_MIRROR 0x40
+#define MCP_IOCON_ODR 0x04
+
 // constructor
 DigitalIn_::DigitalIn_()
 {
   _numPins = 0;
-  for (uint8_t expander = 0; expander < MUX_MAX_NUMBER; expander++)
+  for (uint8_t expander = 0; expander < MUX_MAX_NUMBER + MCP_MAX_NUMBER; expander++)
   {
     _pin[expander] = NOT_USED;
+    _data[expander] = 0;
+    _previous[expander] = 0;
+    _changes[expander] = 0;
   }
+  _anyChanges = false;
+#if MCP_MAX_NUMBER > 0
+  _numMCP = 0;
+#endif
+#if MUX_EVENT_QUEUE > 0
+  _eventFirst = 0;
+  _eventCount = 0;
+  _eventsDropped = 0;
+#endif
   _s0 = NOT_USED;
   _s1 = NOT_USED;
   _s2 = NOT_USED;
   _s3 = NOT_USED;
+  _channel = NOT_USED;
+#if MUX_BACKGROUND_SCAN
+  _background = false;
+#endif
+#ifdef ARDUINO_ARCH_AVR
+  _addrPort = NULL;
+  _numPorts = 0;
+#endif
 }
 
 // configure 74HC4067 adress pins S0-S3
@@ -28,6 +54,7 @@ void DigitalIn_::setMux(uint8_t s0, uint8_t s1, uint8_t s2, uint8_t s3)
   pinMode(_s1, OUTPUT);
   pinMode(_s2, OUTPUT);
   pinMode(_s3, OUTPUT);
+  _channel = NOT_USED;
   #ifdef ARDUINO_ARCH_AVR
   _s0port = digitalPinToPort(_s0);
   _s1port = digitalPinToPort(_s1);
@@ -37,6 +64,16 @@ void DigitalIn_::setMux(uint8_t s0, uint8_t s1, uint8_t s2, uint8_t s3)
   _s1mask = digitalPinToBitMask(_s1);
   _s2mask = digitalPinToBitMask(_s2);
   _s3mask = digitalPinToBitMask(_s3);
+  // all adress lines on one port can be set with a single write
+  if (_s0port == _s1port && _s0port == _s2port && _s0port == _s3port)
+  {
+    _addrPort = portOutputRegister(_s0port);
+    _addrMask = _s0mask | _s1mask | _s2mask | _s3mask;
+  }
+  else
+  {
+    _addrPort = NULL;
+  }
   #endif
 }
 
@@ -47,6 +84,25 @@ bool DigitalIn_::addMux(uint8_t pin)
   {
     return false;
   }
+#ifdef ARDUINO_ARCH_AVR
+  // group data pins by port, so each port is read only once per channel
+  volatile uint8_t *input = portInputRegister(digitalPinToPort(pin));
+  uint8_t port = 0;
+  while (port < _numPorts && _portInput[port] != input)
+  {
+    port++;
+  }
+  if (port == _numPorts)
+  {
+    _portInput[_numPorts++] = input;
+  }
+  _muxPort[_numPins] = port;
+  _muxBit[_numPins] = 0;
+  while (!(digitalPinToBitMask(pin) & (1 << _muxBit[_numPins])))
+  {
+    _muxBit[_numPins]++;
+  }
+#endif
   _pin[_numPins++] = pin;
   pinMode(pin, INPUT);
   return true;
@@ -54,7 +110,7 @@ bool DigitalIn_::addMux(uint8_t pin)
 
 #if MCP_MAX_NUMBER > 0
 // Add a MCP23017
-bool DigitalIn_::addMCP(uint8_t adress)
+bool DigitalIn_::addMCP(uint8_t adress, uint8_t intPin)
 {
   if (_numMCP >= MCP_MAX_NUMBER)
   {
@@ -64,11 +120,34 @@ bool DigitalIn_::addMCP(uint8_t adress)
   {
     return false;
   }
-  for (int i = 0; i < 16; i++)
+  // configure all registers from IODIRA to GPPUB in one sequential write
+  Wire.beginTransmission(adress);
+  Wire.write(MCP_IODIRA);
+  Wire.write(0xFF); // IODIR: all inputs
+  Wire.write(0xFF);
+  Wire.write(0xFF); // IPOL: inverted, GND reads as 1
+  Wire.write(0xFF);
+  Wire.write(0xFF); // GPINTEN: interrupt on change for all inputs
+  Wire.write(0xFF);
+  Wire.write(0x00); // DEFVAL: not used
+  Wire.write(0x00);
+  Wire.write(0x00); // INTCON: compare with previous value
+  Wire.write(0x00);
+  Wire.write(MCP_IOCON_MIRROR | MCP_IOCON_ODR); // IOCON: INTA = INTB, open drain (shared lines possible)
+  Wire.write(MCP_IOCON_MIRROR | MCP_IOCON_ODR);
+  Wire.write(0xFF); // GPPU: all pullups
+  Wire.write(0xFF);
+  if (Wire.endTransmission() != 0)
+  {
+    return false;
+  }
+  _mcpInt[_numMCP] = intPin;
+  if (intPin != NOT_USED)
   {
-    // TODO: register write iodir = 0xffff, ipol = 0xffff, gppu = 0xffff
-    _mcp[_numMCP].pinMode(i, INPUT_PULLUP);
+    pinMode(intPin, INPUT_PULLUP);
   }
+  // initial read, also clears pending interrupts
+  _data[_numPins] = _mcp[_numMCP].readGPIOAB();
   _numMCP++;
   _pin[_numPins++] = MCP_PIN;
   return true;
@@ -89,9 +168,189 @@ bool DigitalIn_::getBit(uint8_t expander, uint8_t channel)
   return bitRead(_data[expander], channel);
 }
 
-// read all inputs together -> base for board specific optimization by using byte read
+// Gets changed channels of expander in the last handle()
+int16_t DigitalIn_::getChanges(uint8_t expander)
+{
+  if (expander >= _numPins)
+  {
+    return 0;
+  }
+  return _changes[expander];
+}
+
+#if MUX_EVENT_QUEUE > 0
+bool DigitalIn_::nextEvent(DigitalInEvent_t *event)
+{
+  if (_eventCount == 0)
+  {
+    return false;
+  }
+  *event = _event[_eventFirst];
+  _eventFirst = (_eventFirst + 1) % MUX_EVENT_QUEUE;
+  _eventCount--;
+  return true;
+}
+#endif
+
+// compare input image with the previous one and queue the changes
+void DigitalIn_::_detectChanges()
+{
+  _anyChanges = false;
+#if MUX_EVENT_QUEUE > 0
+  unsigned long now = millis();
+#endif
+  for (uint8_t expander = 0; expander < _numPins; expander++)
+  {
+    uint16_t changes = _data[expander] ^ _previous[expander];
+    _changes[expander] = changes;
+    _previous[expander] = _data[expander];
+    if (changes == 0)
+    {
+      continue;
+    }
+    _anyChanges = true;
+#if MUX_EVENT_QUEUE > 0
+    for (uint8_t channel = 0; changes != 0; channel++, changes >>= 1)
+    {
+      if (!(changes & 1))
+      {
+        continue;
+      }
+      if (_eventCount >= MUX_EVENT_QUEUE)
+      {
+        _eventsDropped++;
+        continue;
+      }
+      DigitalInEvent_t *event = &_event[(_eventFirst + _eventCount++) % MUX_EVENT_QUEUE];
+      event->expander = expander;
+      event->channel = channel;
+      event->engaged = bitRead(_data[expander], channel);
+      event->time = now;
+    }
+#endif
+  }
+}
+
+// set mux adress, only the lines that change are written
+void DigitalIn_::_setAddress(uint8_t channel)
+{
+  uint8_t changed = (_channel > 15) ? 0x0F : (channel ^ _channel);
+  _channel = channel;
+#ifdef ARDUINO_ARCH_AVR
+  // interrupts may not change other pins on the ports meanwhile
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  if (_addrPort != NULL)
+  {
+    uint8_t bits = (bitRead(channel, 0) ? _s0mask : 0) | (bitRead(channel, 1) ? _s1mask : 0) |
+                   (bitRead(channel, 2) ? _s2mask : 0) | (bitRead(channel, 3) ? _s3mask : 0);
+    *_addrPort = (*_addrPort & ~_addrMask) | bits;
+  }
+  else
+  {
+    if (bitRead(changed, 0))
+      bitRead(channel, 0) ? *portOutputRegister(_s0port) |= _s0mask : *portOutputRegister(_s0port) &= ~_s0mask;
+    if (bitRead(changed, 1))
+      bitRead(channel, 1) ? *portOutputRegister(_s1port) |= _s1mask : *portOutputRegister(_s1port) &= ~_s1mask;
+    if (bitRead(changed, 2))
+      bitRead(channel, 2) ? *portOutputRegister(_s2port) |= _s2mask : *portOutputRegister(_s2port) &= ~_s2mask;
+    if (bitRead(changed, 3))
+      bitRead(channel, 3) ? *portOutputRegister(_s3port) |= _s3mask : *portOutputRegister(_s3port) &= ~_s3mask;
+  }
+  SREG = oldSREG;
+#else
+  if (bitRead(changed, 0))
+    digitalWrite(_s0, bitRead(channel, 0));
+  if (bitRead(changed, 1))
+    digitalWrite(_s1, bitRead(channel, 1));
+  if (bitRead(changed, 2))
+    digitalWrite(_s2, bitRead(channel, 2));
+  if (bitRead(changed, 3))
+    digitalWrite(_s3, bitRead(channel, 3));
+#endif
+}
+
+#ifdef ARDUINO_ARCH_AVR
+// 8x8 bit matrix transpose: columns[b] bit c = rows[c] bit b (Hacker's Delight, transpose8rS32)
+static void transpose8(const uint8_t *rows, uint8_t *columns)
+{
+  uint32_t x = ((uint32_t)rows[7] << 24) | ((uint32_t)rows[6] << 16) | ((uint32_t)rows[5] << 8) | rows[4];
+  uint32_t y = ((uint32_t)rows[3] << 24) | ((uint32_t)rows[2] << 16) | ((uint32_t)rows[1] << 8) | rows[0];
+  uint32_t t;
+  t = (x ^ (x >> 7)) & 0x00AA00AA;
+  x = x ^ t ^ (t << 7);
+  t = (y ^ (y >> 7)) & 0x00AA00AA;
+  y = y ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC;
+  x = x ^ t ^ (t << 14);
+  t = (y ^ (y >> 14)) & 0x0000CCCC;
+  y = y ^ t ^ (t << 14);
+  t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+  y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+  columns[7] = t >> 24;
+  columns[6] = t >> 16;
+  columns[5] = t >> 8;
+  columns[4] = t;
+  columns[3] = y >> 24;
+  columns[2] = y >> 16;
+  columns[1] = y >> 8;
+  columns[0] = y;
+}
+#endif
+
+#if MUX_BACKGROUND_SCAN
+// critical sections with tick() restore the interrupt state of the caller. It is known on AVR and ARM Cortex-M,
+// elsewhere interrupts are assumed enabled before.
+#if defined(__arm__) && defined(__ARM_ARCH_PROFILE) && __ARM_ARCH_PROFILE == 'M'
+#define MUX_CORTEX_M 1
+#endif
+
+static uint32_t lockInterrupts()
+{
+#if defined(ARDUINO_ARCH_AVR)
+  uint32_t state = SREG;
+#elif defined(MUX_CORTEX_M)
+  uint32_t state;
+  __asm__ volatile("mrs %0, primask" : "=r"(state));
+#else
+  uint32_t state = 0;
+#endif
+  noInterrupts();
+  return state;
+}
+
+static void unlockInterrupts(uint32_t state)
+{
+#if defined(ARDUINO_ARCH_AVR)
+  SREG = (uint8_t)state;
+#elif defined(MUX_CORTEX_M)
+  __asm__ volatile("msr primask, %0" : : "r"(state) : "memory");
+#else
+  (void)state;
+  interrupts();
+#endif
+}
+#endif
+
+// read all inputs together
 void DigitalIn_::handle()
 {
+  XPL_PROFILE_SCOPE("DigitalIn");
+#if MUX_BACKGROUND_SCAN
+  if (_background)
+  { // consistent snapshot for this loop
+    uint32_t state = lockInterrupts();
+    for (uint8_t expander = 0; expander < _numPins; expander++)
+    {
+      if (_pin[expander] != MCP_PIN)
+      {
+        _data[expander] = _scanFront[expander];
+      }
+    }
+    unlockInterrupts(state);
+  }
+  else
+#endif
   // only if Mux Pins present
 #if MCP_MAX_NUMBER > 0  
   if (_numPins > _numMCP)
@@ -99,35 +358,51 @@ void DigitalIn_::handle()
   if (_numPins > 0)
 #endif
   {
-    for (uint8_t channel = 0; channel < 16; channel++)
-    {
 #ifdef ARDUINO_ARCH_AVR
-      uint8_t oldSREG = SREG;
-      noInterrupts();
-      bitRead(channel, 0) ? *portOutputRegister(_s0port) |= _s0mask : *portOutputRegister(_s0port) &= ~_s0mask;
-      bitRead(channel, 1) ? *portOutputRegister(_s1port) |= _s1mask : *portOutputRegister(_s1port) &= ~_s1mask;
-      bitRead(channel, 2) ? *portOutputRegister(_s2port) |= _s2mask : *portOutputRegister(_s2port) &= ~_s2mask;
-      bitRead(channel, 3) ? *portOutputRegister(_s3port) |= _s3mask : *portOutputRegister(_s3port) &= ~_s3mask;
-      SREG = oldSREG;
-      delayMicroseconds(1);
+    // one read per port and channel, bits are sorted out afterwards
+    uint8_t samples[MUX_MAX_NUMBER][16];
+    for (uint8_t step = 0; step < 16; step++)
+    {
+      uint8_t channel = step ^ (step >> 1); // gray code, only one adress line changes per step
+      _setAddress(channel);
+#if MUX_SETTLE_TIME > 0
+      delayMicroseconds(MUX_SETTLE_TIME);
+#endif
+      for (uint8_t port = 0; port < _numPorts; port++)
+      {
+        samples[port][channel] = *_portInput[port];
+      }
+    }
+    for (uint8_t port = 0; port < _numPorts; port++)
+    {
+      uint8_t low[8], high[8];
+      transpose8(&samples[port][0], low);
+      transpose8(&samples[port][8], high);
+      for (uint8_t expander = 0; expander < _numPins; expander++)
+      {
+        if (_pin[expander] != MCP_PIN && _muxPort[expander] == port)
+        {
+          _data[expander] = ~((high[_muxBit[expander]] << 8) | low[_muxBit[expander]]);
+        }
+      }
+    }
 #else
-      digitalWrite(_s0, bitRead(channel, 0));
-      digitalWrite(_s1, bitRead(channel, 1));
-      digitalWrite(_s2, bitRead(channel, 2));
-      digitalWrite(_s3, bitRead(channel, 3));
+    for (uint8_t step = 0; step < 16; step++)
+    {
+      uint8_t channel = step ^ (step >> 1); // gray code, only one adress line changes per step
+      _setAddress(channel);
+#if MUX_SETTLE_TIME > 0
+      delayMicroseconds(MUX_SETTLE_TIME);
 #endif
       for (uint8_t expander = 0; expander < _numPins; expander++)
       {
         if (_pin[expander] != MCP_PIN)
         {
-#ifdef ARDUINO_ARCH_AVR
-          bitWrite(_data[expander], channel, (*portInputRegister(digitalPinToPort(_pin[expander])) & digitalPinToBitMask(_pin[expander])) ? false : true);
-#else
           bitWrite(_data[expander], channel, !digitalRead(_pin[expander]));
-#endif
         }
       }
     }
+#endif
   }
 #if MCP_MAX_NUMBER > 0
   int mcp = 0;
@@ -135,10 +410,56 @@ void DigitalIn_::handle()
   {
     if (_pin[expander] == MCP_PIN)
     {
-      _data[expander] = ~_mcp[mcp++].readGPIOAB();
+      // only read on change when interrupt line is connected, reading clears the interrupt
+      if (_mcpInt[mcp] == NOT_USED || !digitalRead(_mcpInt[mcp]))
+      {
+        _data[expander] = _mcp[mcp].readGPIOAB();
+      }
+      mcp++;
     }
   }
 #endif
+  _detectChanges();
 }
 
+#if MUX_BACKGROUND_SCAN
+void DigitalIn_::setBackgroundScan(bool enable)
+{
+  uint32_t state = lockInterrupts();
+  _background = enable;
+  _scanStep = 0;
+  _setAddress(0);
+  unlockInterrupts(state);
+}
+
+// one channel per call, the adress was set on the previous call
+void DigitalIn_::tick()
+{
+  if (!_background)
+  {
+    return;
+  }
+  for (uint8_t expander = 0; expander < _numPins; expander++)
+  {
+    if (_pin[expander] != MCP_PIN)
+    {
+#ifdef ARDUINO_ARCH_AVR
+      bitWrite(_scanBack[expander], _channel, (*_portInput[_muxPort[expander]] & (1 << _muxBit[expander])) ? false : true);
+#else
+      bitWrite(_scanBack[expander], _channel, !digitalRead(_pin[expander]));
+#endif
+    }
+  }
+  if (++_scanStep >= 16)
+  { // publish complete scan
+    _scanStep = 0;
+    for (uint8_t expander = 0; expander < _numPins; expander++)
+    {
+      _scanFront[expander] = _scanBack[expander];
+    }
+  }
+  _setAddress(_scanStep ^ (_scanStep >> 1));
+}
+#endif
+
 DigitalIn_ DigitalIn;
@@ -16,6 +16,7 @@ Encoder::Encoder(uint8_t mux, uint8_t pin1, uint8_t pin2, uint8_t pin3, EncPulse
   _pulses = pulses;
   _count = 0;
   _state = 0;
+  _debounce = 0;
   _transition = transNone;
   _cmdUp = -1;
   _cmdDown = -1;
@@ -74,6 +75,19 @@ void Encoder::handle()
   }
 }
 
+bool Encoder::idle()
+{
+  if ((_state & 0x03) != ((DigitalIn.getBit(_mux, _pin2) << 1) | DigitalIn.getBit(_mux, _pin1)))
+  { // a step not counted yet
+    return false;
+  }
+  if (_pin3 == NOT_USED)
+  {
+    return true;
+  }
+  return DigitalIn.getBit(_mux, _pin3) ? _debounce == DEBOUNCE_DELAY : _debounce == 0;
+}
+
 void Encoder::setCommand(int cmdUp, int cmdDown, int cmdPush)
 {
   _cmdUp = cmdUp;
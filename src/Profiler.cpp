@@ -0,0 +1,133 @@
+#include <Arduino.h>
+#include "Profiler.h"
+
+#if XPL_PROFILE
+
+// constructor
+Profiler_::Profiler_()
+{
+  _numProbes = 0;
+  reset();
+}
+
+// register a named probe
+int8_t Profiler_::addProbe(XPString_t *name)
+{
+  if (_numProbes >= PROFILE_MAX_PROBES)
+  {
+    return -1;
+  }
+  _name[_numProbes] = name;
+  _clear(&_probe[_numProbes]);
+  return _numProbes++;
+}
+
+// add measurement to probe
+void Profiler_::record(int8_t probe, unsigned long time)
+{
+  if (probe >= 0 && probe < _numProbes)
+  {
+    _add(&_probe[probe], time);
+  }
+}
+
+// measure loop period since last call
+void Profiler_::loop()
+{
+  unsigned long now = micros();
+  if (_lastLoop != 0)
+  {
+    unsigned long period = now - _lastLoop;
+    _add(&_loop, period);
+    _histogram[min(period / PROFILE_BUCKET_US, (unsigned long)PROFILE_BUCKETS - 1)]++;
+  }
+  _lastLoop = now;
+}
+
+// send all statistics as debug messages and restart
+void Profiler_::report()
+{
+  for (int8_t probe = 0; probe < _numProbes; probe++)
+  {
+    _send(_name[probe], &_probe[probe]);
+  }
+  _send(NULL, &_loop);
+  char msg[XPLMAX_PACKETSIZE - 10];
+  int len = snprintf(msg, sizeof(msg), "hist %uus", PROFILE_BUCKET_US);
+  for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++)
+  {
+    int n = snprintf(&msg[len], sizeof(msg) - len, " %u", _histogram[bucket]);
+    if (n >= (int)sizeof(msg) - len)
+    { // no partial counts, the buckets that do not fit are left out
+      msg[len] = 0;
+      break;
+    }
+    len += n;
+  }
+  XP.sendDebugMessage(msg);
+  reset();
+}
+
+// reset all statistics, probes stay registered
+void Profiler_::reset()
+{
+  for (int8_t probe = 0; probe < _numProbes; probe++)
+  {
+    _clear(&_probe[probe]);
+  }
+  _clear(&_loop);
+  for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++)
+  {
+    _histogram[bucket] = 0;
+  }
+  _lastLoop = 0;
+}
+
+void Profiler_::_clear(Stat_t *stat)
+{
+  stat->min = 0xFFFFFFFF;
+  stat->max = 0;
+  stat->sum = 0;
+  stat->count = 0;
+}
+
+void Profiler_::_add(Stat_t *stat, unsigned long time)
+{
+  stat->min = min(stat->min, time);
+  stat->max = max(stat->max, time);
+  stat->sum += time;
+  stat->count++;
+}
+
+// one line per probe: name n=count min/max/mean in us, no name for the loop period
+void Profiler_::_send(XPString_t *name, Stat_t *stat)
+{
+  char msg[XPLMAX_PACKETSIZE - 10];
+  if (name == NULL)
+  {
+    strcpy(msg, "loop");
+  }
+  else
+  {
+#if XPL_USE_PROGMEM
+    strncpy_P(msg, (const char *)name, 20);
+#else
+    strncpy(msg, name, 20);
+#endif
+  }
+  msg[20] = 0;
+  size_t len = strlen(msg);
+  if (stat->count == 0)
+  {
+    snprintf(&msg[len], sizeof(msg) - len, " n=0");
+  }
+  else
+  {
+    snprintf(&msg[len], sizeof(msg) - len, " n=%lu %lu/%lu/%lu us", stat->count, stat->min, stat->max, stat->sum / stat->count);
+  }
+  XP.sendDebugMessage(msg);
+}
+
+Profiler_ Profiler;
+
+#endif
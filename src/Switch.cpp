@@ -11,6 +11,8 @@ Switch::Switch(uint8_t mux, uint8_t pin)
   _mux = mux;
   _pin = pin;
   _state = switchOff;
+  _debounce = 0;
+  _transition = false;
   _cmdOn = -1;
   _cmdOff = -1;
   if(mux == NOT_USED) {
@@ -40,6 +42,11 @@ void Switch::handle()
   }
 }
 
+bool Switch::idle()
+{
+  return _debounce == 0 && _state == (DigitalIn.getBit(_mux, _pin) ? switchOn : switchOff);
+}
+
 void Switch::setCommand(int cmdOn)
 {
   _cmdOn = cmdOn;
@@ -101,6 +108,8 @@ Switch2::Switch2(uint8_t mux, uint8_t pin1, uint8_t pin2)
   _pin1 = pin1;
   _pin2 = pin2;
   _state = switchOff;
+  _debounce = 0;
+  _transition = false;
   _cmdOff = -1;
   _cmdOn1 = -1;
   _cmdOn2 = -1;
@@ -138,6 +147,20 @@ void Switch2::handle()
   }
 }
 
+bool Switch2::idle()
+{
+  SwState_t input = switchOff;
+  if (DigitalIn.getBit(_mux, _pin1))
+  {
+    input = switchOn1;
+  }
+  else if (DigitalIn.getBit(_mux, _pin2))
+  {
+    input = switchOn2;
+  }
+  return _debounce == 0 && _state == input;
+}
+
 void Switch2::setCommand(int cmdUp, int cmdDown)
 {
   _cmdOn1 = cmdUp;
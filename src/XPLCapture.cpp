@@ -0,0 +1,263 @@
+#include <Arduino.h>
+#include "XPLCapture.h"
+
+// constructor
+XPLCapture::XPLCapture(Stream *device)
+{
+  _device = device;
+  _dropped = 0;
+  clear();
+}
+
+void XPLCapture::clear()
+{
+  _empty();
+  _lastTime = millis();
+}
+
+// drop all records, the time of the next record stays relative to the last one
+void XPLCapture::_empty()
+{
+  _head = 0;
+  _tail = 0;
+  _used = 0;
+  _open = -1;
+}
+
+int XPLCapture::dump(Print *out)
+{
+  int count = 0;
+  while (count < _used)
+  {
+    out->write(_at(_tail + count++));
+  }
+  _empty();
+  return count;
+}
+
+int XPLCapture::dump(byte *buffer, int size)
+{
+  int count = 0;
+  while (count < _used)
+  {
+    int length = XPLCAPTURE_HEADER + (_at(_tail + count) & XPLCAPTURE_MAXLENGTH);
+    if (count + length > size)
+    { // only complete records
+      break;
+    }
+    for (int i = 0; i < length; i++, count++)
+    {
+      buffer[count] = _at(_tail + count);
+    }
+  }
+  _empty();
+  return count;
+}
+
+int XPLCapture::available()
+{
+  return _device->available();
+}
+
+int XPLCapture::read()
+{
+  int data = _device->read();
+  if (data >= 0)
+  {
+    uint8_t c = data;
+    _record(0, &c, 1);
+  }
+  return data;
+}
+
+int XPLCapture::peek()
+{
+  return _device->peek();
+}
+
+size_t XPLCapture::write(uint8_t data)
+{
+  size_t count = _device->write(data);
+  _record(XPLCAPTURE_TX, &data, count);
+  return count;
+}
+
+size_t XPLCapture::write(const uint8_t *buffer, size_t size)
+{
+  size_t count = _device->write(buffer, size);
+  _record(XPLCAPTURE_TX, buffer, count);
+  return count;
+}
+
+int XPLCapture::availableForWrite()
+{
+  return _device->availableForWrite();
+}
+
+void XPLCapture::flush()
+{
+  _device->flush();
+}
+
+// append data to the open record or start a new one
+void XPLCapture::_record(byte direction, const uint8_t *data, int length)
+{
+  unsigned long now = millis();
+  while (length > 0)
+  {
+    if (_open >= 0 && (_buffer[_open] & XPLCAPTURE_TX) == direction && now == _lastTime &&
+        (_buffer[_open] & XPLCAPTURE_MAXLENGTH) < XPLCAPTURE_MAXLENGTH)
+    {
+      int count = min(length, XPLCAPTURE_MAXLENGTH - (_buffer[_open] & XPLCAPTURE_MAXLENGTH));
+      while (_open >= 0 && _used + count > XPLCAPTURE_BUFFER)
+      {
+        _dropOldest();
+      }
+      if (_open < 0)
+      { // the open record itself was dropped
+        continue;
+      }
+      _buffer[_open] += count;
+      for (int i = 0; i < count; i++)
+      {
+        _put(*data++);
+      }
+      length -= count;
+    }
+    else
+    {
+      int count = min(length, min(XPLCAPTURE_MAXLENGTH, XPLCAPTURE_BUFFER - XPLCAPTURE_HEADER));
+      while (_used + XPLCAPTURE_HEADER + count > XPLCAPTURE_BUFFER)
+      {
+        _dropOldest();
+      }
+      unsigned long delta = min(now - _lastTime, 0xFFFFUL);
+      _lastTime = now;
+      _open = _head;
+      _put(direction | count);
+      _put(delta & 0xFF);
+      _put(delta >> 8);
+      for (int i = 0; i < count; i++)
+      {
+        _put(*data++);
+      }
+      length -= count;
+    }
+  }
+}
+
+void XPLCapture::_put(byte data)
+{
+  _buffer[_head] = data;
+  if (++_head >= XPLCAPTURE_BUFFER)
+  {
+    _head = 0;
+  }
+  _used++;
+}
+
+byte XPLCapture::_at(int pos)
+{
+  return _buffer[pos % XPLCAPTURE_BUFFER];
+}
+
+void XPLCapture::_dropOldest()
+{
+  int length = XPLCAPTURE_HEADER + (_buffer[_tail] & XPLCAPTURE_MAXLENGTH);
+  if (_open == _tail)
+  {
+    _open = -1;
+  }
+  _tail = (_tail + length) % XPLCAPTURE_BUFFER;
+  _used -= length;
+  _dropped++;
+}
+
+// constructor
+XPLReplay::XPLReplay(const byte *capture, int length)
+{
+  _capture = capture;
+  _length = length;
+  restart();
+}
+
+void XPLReplay::restart()
+{
+  _rx.pos = _tx.pos = 0;
+  _rx.remaining = _tx.remaining = 0;
+  _rx.time = _tx.time = 0;
+  if (_length >= XPLCAPTURE_HEADER)
+  {
+    _rx.remaining = _tx.remaining = _capture[0] & XPLCAPTURE_MAXLENGTH;
+    _rx.time = _tx.time = _capture[1] | ((unsigned int)_capture[2] << 8);
+  }
+  _start = millis(); // corresponds to the start of the capture
+  _mismatches = 0;
+}
+
+int XPLReplay::available()
+{
+  _seek(&_rx, 0);
+  if (_rx.pos >= _length || millis() - _start < _rx.time)
+  {
+    return 0;
+  }
+  return _rx.remaining;
+}
+
+int XPLReplay::read()
+{
+  if (!available())
+  {
+    return -1;
+  }
+  int length = _capture[_rx.pos] & XPLCAPTURE_MAXLENGTH;
+  return _capture[_rx.pos + XPLCAPTURE_HEADER + length - _rx.remaining--];
+}
+
+int XPLReplay::peek()
+{
+  if (!available())
+  {
+    return -1;
+  }
+  int length = _capture[_rx.pos] & XPLCAPTURE_MAXLENGTH;
+  return _capture[_rx.pos + XPLCAPTURE_HEADER + length - _rx.remaining];
+}
+
+// compare with recorded data, sent data is never delayed
+size_t XPLReplay::write(uint8_t data)
+{
+  _seek(&_tx, XPLCAPTURE_TX);
+  if (_tx.pos >= _length)
+  {
+    _mismatches++;
+    return 1;
+  }
+  int length = _capture[_tx.pos] & XPLCAPTURE_MAXLENGTH;
+  if (_capture[_tx.pos + XPLCAPTURE_HEADER + length - _tx.remaining--] != data)
+  {
+    _mismatches++;
+  }
+  return 1;
+}
+
+// move cursor to the next record of direction with data left, adding up the time
+void XPLReplay::_seek(Cursor_t *cursor, byte direction)
+{
+  while (cursor->pos < _length && (cursor->remaining == 0 || (_capture[cursor->pos] & XPLCAPTURE_TX) != direction))
+  {
+    cursor->pos += XPLCAPTURE_HEADER + (_capture[cursor->pos] & XPLCAPTURE_MAXLENGTH);
+    if (cursor->pos + XPLCAPTURE_HEADER > _length)
+    {
+      cursor->pos = _length;
+      break;
+    }
+    cursor->remaining = _capture[cursor->pos] & XPLCAPTURE_MAXLENGTH;
+    cursor->time += _capture[cursor->pos + 1] | ((unsigned int)_capture[cursor->pos + 2] << 8);
+    if (cursor->pos + XPLCAPTURE_HEADER + cursor->remaining > _length)
+    { // truncated record
+      cursor->pos = _length;
+    }
+  }
+}
@@ -6,12 +6,18 @@
 
 #include <Arduino.h>
 #include "XPLDirect.h"
+#include "Profiler.h"
 
 // Methods
 XPLDirect::XPLDirect(Stream* device)
 {
   streamPtr = device;
-  streamPtr->setTimeout(XPLDIRECT_RX_TIMEOUT);
+}
+
+void XPLDirect::begin(const char *devicename, Stream *device)
+{
+  streamPtr = device;
+  begin(devicename);
 }
 
 void XPLDirect::begin(const char *devicename)
@@ -19,54 +25,253 @@ void XPLDirect::begin(const char *devicename)
   _deviceName = (char *)devicename;
   _connectionStatus = 0;
   _dataRefsCount = 0;
+  _writeRefsCount = 0;
+  _readRefsCount = 0;
   _commandsCount = 0;
+  _registrationsDropped = 0;
   _allDataRefsRegistered = 0;
   _receiveBuffer[0] = 0;
+  _receiveBufferBytesReceived = 0;
+  _receiveState = XPL_RX_IDLE;
+  _clearHandleMap();
+  _lastReceiveTime = 0;
+  _rxMalformedFrames = 0;
+  _rxOversizeFrames = 0;
+  _capabilities = 0;
+  _binaryMode = false;
+  _registerPolls = 0;
+  _multiUpdateCount = 0;
+  _dueCount = 0;
+  memset(_changedSet, 0, sizeof(_changedSet));
+  _changedAny = false;
+  _txOverflows = 0;
+  _rxDroppedFrames = 0;
+  _handshakeStart = 0;
+  _handshakeTime = 0;
+#if XPLDIRECT_STATISTICS
+  resetStatistics();
+#endif
+#if XPLDIRECT_TX_BUFFER > 0
+  _txNormalLane.buffer = _txNormalBuffer;
+  _txNormalLane.size = XPLDIRECT_TX_BUFFER;
+  _txPriorityLane.buffer = _txPriorityBuffer;
+  _txPriorityLane.size = XPLDIRECT_TX_PRIORITY_BUFFER;
+  _txNormalLane.head = _txNormalLane.tail = _txNormalLane.used = 0;
+  _txPriorityLane.head = _txPriorityLane.tail = _txPriorityLane.used = 0;
+  _txLane = &_txNormalLane;
+  _txFrameRemaining = 0;
+#endif
 }
 
 int XPLDirect::xloop(void)
 {
+  XPL_PROFILE_SCOPE("xloop");
+  if (_changedAny)
+  { // changed set only holds the updates of one loop
+    memset(_changedSet, 0, sizeof(_changedSet));
+    _changedAny = false;
+  }
   _processSerial();
+#if XPLDIRECT_TX_BUFFER > 0
+  _drainTx(false); // responses and frames queued since last loop
+#endif
   if (!_allDataRefsRegistered)
   {
     return _connectionStatus;
   }
-  // process datarefs to send
-  for (int i = 0; i < _dataRefsCount; i++)
+  // process datarefs that are due, the rest costs nothing
+  unsigned long now = millis();
+  while (_dueCount > 0 && (long)(now - _dataRefs[_dueHeap[0]].nextUpdateTime) >= 0)
+  {
+    int i = _heapPop();
+    if (_dataRefs[i].dataRefHandle < 0)
+    { // registration lost, scheduled again when registered
+      continue;
+    }
+    bool sent = _sendDataRef(i);
+    _dataRefs[i].dirty = false;
+    if (sent)
+    {
+      _dataRefs[i].nextUpdateTime = now + _dataRefs[i].updateRate + 1;
+    }
+    else if (!_dataRefs[i].explicitDirty)
+    {
+      _dataRefs[i].nextUpdateTime = now + 1; // poll again next millisecond
+    }
+    if (!_dataRefs[i].explicitDirty || sent)
+    { // polled datarefs stay scheduled, marked ones until the rate limit passed
+      _heapPush(i);
+    }
+  }
+  _flushUpdates();
+#if XPLDIRECT_TX_BUFFER > 0
+  _drainTx(false);
+#endif
+  return _connectionStatus;
+}
+
+// send dataref if changed, returns true when sent
+bool XPLDirect::_sendDataRef(int i)
+{
+  switch (_dataRefs[i].dataRefVARType)
+  {
+  case XPL_DATATYPE_INT:
+    if (*(long int *)_dataRefs[i].latestValue != _dataRefs[i].lastSentIntValue)
+    {
+      _sendUpdate(_dataRefs[i].dataRefHandle, *(long int *)_dataRefs[i].latestValue);
+      _dataRefs[i].lastSentIntValue = *(long int *)_dataRefs[i].latestValue;
+      _dataRefs[i].forceUpdate = 0;
+      return true;
+    }
+    break;
+  case XPL_DATATYPE_FLOAT:
   {
-    if (_dataRefs[i]->dataRefHandle >= 0 && (_dataRefs[i]->dataRefRWType == XPL_WRITE || _dataRefs[i]->dataRefRWType == XPL_READWRITE))
+    float value = *(float *)_dataRefs[i].latestValue; // the users variable is left untouched
+    float sendValue = value;
+    if (_dataRefs[i].divider > 0)
+    {
+      sendValue = ((int)(value / _dataRefs[i].divider) * _dataRefs[i].divider);
+    }
+    if (sendValue == _dataRefs[i].lastSentFloatValue)
     {
-      if ((millis() - _dataRefs[i]->lastUpdateTime > _dataRefs[i]->updateRate) || _dataRefs[i]->forceUpdate)
+      break;
+    }
+    // the raw value has to leave the deadband around the last sent value. As the last sent value sits on a
+    // quantization step this also gives hysteresis when the raw value is noisy around a step boundary.
+    if (!_dataRefs[i].forceUpdate)
+    {
+      float deadband = max(_dataRefs[i].deadband, _dataRefs[i].deadbandRelative * fabs(_dataRefs[i].lastSentFloatValue));
+      if (fabs(value - _dataRefs[i].lastSentFloatValue) <= deadband)
       {
-        switch (_dataRefs[i]->dataRefVARType)
-        {
-        case XPL_DATATYPE_INT:
-          if (*(long int *)_dataRefs[i]->latestValue != _dataRefs[i]->lastSentIntValue)
-          {
-            _sendPacketInt(XPLCMD_DATAREFUPDATE, _dataRefs[i]->dataRefHandle, *(long int *)_dataRefs[i]->latestValue);
-            _dataRefs[i]->lastSentIntValue = *(long int *)_dataRefs[i]->latestValue;
-            _dataRefs[i]->lastUpdateTime = millis();
-            _dataRefs[i]->forceUpdate = 0;
-          }
-          break;
-        case XPL_DATATYPE_FLOAT:
-          if (_dataRefs[i]->divider > 0)
-          {
-            *(float *)_dataRefs[i]->latestValue = ((int)(*(float *)_dataRefs[i]->latestValue / _dataRefs[i]->divider) * _dataRefs[i]->divider);
-          }
-          if (*(float *)_dataRefs[i]->latestValue != _dataRefs[i]->lastSentFloatValue)
-          {
-            _sendPacketFloat(XPLCMD_DATAREFUPDATE, _dataRefs[i]->dataRefHandle, *(float *)_dataRefs[i]->latestValue);
-            _dataRefs[i]->lastSentFloatValue = *(float *)_dataRefs[i]->latestValue;
-            _dataRefs[i]->lastUpdateTime = millis();
-            _dataRefs[i]->forceUpdate = 0;
-          }
-          break;
-        }
+        break;
       }
     }
+    _sendUpdate(_dataRefs[i].dataRefHandle, sendValue, _dataRefs[i].decimals);
+    _dataRefs[i].lastSentFloatValue = sendValue;
+    _dataRefs[i].forceUpdate = 0;
+    return true;
   }
-  return _connectionStatus;
+  }
+  return false;
+}
+
+int XPLDirect::markDirty(int handle)
+{
+  if (handle < 0 || handle >= _dataRefsCount)
+  { // invalid handle
+    return -1;
+  }
+  if (_dataRefInfo[handle].dataRefRWType == XPL_READ)
+  { // nothing to send
+    return -1;
+  }
+  _dataRefs[handle].explicitDirty = true; // from now on only checked when marked
+  if (!_dataRefs[handle].dirty)
+  {
+    _dataRefs[handle].dirty = true;
+    if (_allDataRefsRegistered && !_dataRefs[handle].queued)
+    {
+      _scheduleDataRef(handle, millis());
+    }
+  }
+  return 0;
+}
+
+int XPLDirect::setDeadband(int handle, float absolute, float relative)
+{
+  if (handle < 0 || handle >= _dataRefsCount)
+  { // invalid handle
+    return -1;
+  }
+  if (_dataRefs[handle].dataRefVARType != XPL_DATATYPE_FLOAT || absolute < 0 || relative < 0)
+  {
+    return -1;
+  }
+  _dataRefs[handle].deadband = absolute;
+  _dataRefs[handle].deadbandRelative = relative;
+  return 0;
+}
+
+// Scheduler for outgoing datarefs, binary min heap ordered by nextUpdateTime
+void XPLDirect::_scheduleDataRef(int i, unsigned long now)
+{
+  unsigned long due = _dataRefs[i].nextUpdateTime;
+  if (_dataRefs[i].forceUpdate || (long)(due - now) < 0)
+  {
+    due = now;
+  }
+  _dataRefs[i].nextUpdateTime = due;
+  _heapPush(i);
+}
+
+void XPLDirect::_rebuildSchedule()
+{
+  unsigned long now = millis();
+  for (int i = 0; i < _dueCount; i++)
+  {
+    _dataRefs[_dueHeap[i]].queued = false;
+  }
+  _dueCount = 0;
+  for (int w = 0; w < _writeRefsCount; w++)
+  {
+    int i = _writeRefs[w];
+    if (_dataRefs[i].dataRefHandle >= 0 && (!_dataRefs[i].explicitDirty || _dataRefs[i].dirty || _dataRefs[i].forceUpdate))
+    {
+      _scheduleDataRef(i, now);
+    }
+  }
+}
+
+bool XPLDirect::_heapBefore(int a, int b)
+{
+  return (long)(_dataRefs[_dueHeap[a]].nextUpdateTime - _dataRefs[_dueHeap[b]].nextUpdateTime) < 0;
+}
+
+void XPLDirect::_heapSwap(int a, int b)
+{
+  _indexType tmp = _dueHeap[a];
+  _dueHeap[a] = _dueHeap[b];
+  _dueHeap[b] = tmp;
+}
+
+void XPLDirect::_heapPush(int i)
+{
+  int pos = _dueCount++;
+  _dueHeap[pos] = i;
+  _dataRefs[i].queued = true;
+  while (pos > 0 && _heapBefore(pos, (pos - 1) / 2))
+  {
+    _heapSwap(pos, (pos - 1) / 2);
+    pos = (pos - 1) / 2;
+  }
+}
+
+int XPLDirect::_heapPop()
+{
+  int i = _dueHeap[0];
+  _dataRefs[i].queued = false;
+  _dueHeap[0] = _dueHeap[--_dueCount];
+  int pos = 0;
+  while (true)
+  {
+    int next = pos;
+    int child = 2 * pos + 1;
+    if (child < _dueCount && _heapBefore(child, next))
+    {
+      next = child;
+    }
+    if (child + 1 < _dueCount && _heapBefore(child + 1, next))
+    {
+      next = child + 1;
+    }
+    if (next == pos)
+    {
+      break;
+    }
+    _heapSwap(pos, next);
+    pos = next;
+  }
+  return i;
 }
 
 int XPLDirect::commandTrigger(int commandHandle)
@@ -75,15 +280,11 @@ int XPLDirect::commandTrigger(int commandHandle)
   { // invalid handle
     return -1;
   } 
-  if (!_commands[commandHandle])
-  { // inactive command
-    return -1;
-  } 
 #if XPL_DEBUG
   Serial.print("Command Trigger: ");
-  Serial.println(_commands[commandHandle]->commandName);
+  Serial.println(_commands[commandHandle].commandName);
 #endif
-  _sendPacketInt(XPLCMD_COMMANDTRIGGER, _commands[commandHandle]->commandHandle, 1);
+  _sendPacketInt(XPLCMD_COMMANDTRIGGER, _commands[commandHandle].commandHandle, 1);
   return 0;
 }
 
@@ -93,18 +294,14 @@ int XPLDirect::commandTrigger(int commandHandle, int triggerCount)
   { // invalid handle
     return -1;
   } 
-  if (!_commands[commandHandle])
-  { // inactive command
-    return -1;
-  }
 #if XPL_DEBUG
   Serial.print("Command Trigger: ");
-  Serial.print(_commands[commandHandle]->commandName);
+  Serial.print(_commands[commandHandle].commandName);
   Serial.print(" ");
   Serial.print(triggerCount);
   Serial.println(" times");
 #endif
-  _sendPacketInt(XPLCMD_COMMANDTRIGGER, _commands[commandHandle]->commandHandle, (long int)triggerCount);
+  _sendPacketInt(XPLCMD_COMMANDTRIGGER, _commands[commandHandle].commandHandle, (long int)triggerCount);
   return 0;
 }
 
@@ -114,15 +311,11 @@ int XPLDirect::commandStart(int commandHandle)
   { // invalid handle
     return -1;
   } 
-  if (!_commands[commandHandle])
-  { // inactive command
-    return -1;
-  }
 #if XPL_DEBUG
   Serial.print("Command Start  : ");
-  Serial.println(_commands[commandHandle]->commandName);
+  Serial.println(_commands[commandHandle].commandName);
 #endif
-  _sendPacketVoid(XPLCMD_COMMANDSTART, _commands[commandHandle]->commandHandle);
+  _sendPacketVoid(XPLCMD_COMMANDSTART, _commands[commandHandle].commandHandle);
   return 0;
 }
 
@@ -132,15 +325,11 @@ int XPLDirect::commandEnd(int commandHandle)
   { // invalid handle
     return -1;
   } 
-  if (!_commands[commandHandle])
-  { // inactive command
-    return -1;
-  }
 #if XPL_DEBUG
   Serial.print("Command End    : ");
-  Serial.println(_commands[commandHandle]->commandName);
+  Serial.println(_commands[commandHandle].commandName);
 #endif
-  _sendPacketVoid(XPLCMD_COMMANDEND, _commands[commandHandle]->commandHandle);
+  _sendPacketVoid(XPLCMD_COMMANDEND, _commands[commandHandle].commandHandle);
   return 0;
 }
 
@@ -163,14 +352,71 @@ int XPLDirect::sendSpeakMessage(const char* msg)
 
 int XPLDirect::hasUpdated(int handle)
 {
-  if (_dataRefs[handle]->updatedFlag)
+  if (handle < 0 || handle >= _dataRefsCount)
+  { // invalid handle
+    return false;
+  }
+  if (_dataRefs[handle].updatedFlag)
   {
-    _dataRefs[handle]->updatedFlag = false;
+    _dataRefs[handle].updatedFlag = false;
     return true;
   }
   return false;
 }
 
+int XPLDirect::nextChanged(int handle)
+{
+  if (!_changedAny)
+  {
+    return -1;
+  }
+  int i = max(handle + 1, 0);
+  while (i < _dataRefsCount)
+  {
+    byte bits = _changedSet[i >> 3] >> (i & 7);
+    if (bits == 0)
+    { // skip to next byte
+      i = (i | 7) + 1;
+    }
+    else
+    {
+      while (!(bits & 1))
+      {
+        bits >>= 1;
+        i++;
+      }
+      return i;
+    }
+  }
+  return -1;
+}
+
+int XPLDirect::setCallback(int handle, XPLDataRefCallback callback)
+{
+  if (handle < 0 || handle >= _dataRefsCount)
+  { // invalid handle
+    return -1;
+  }
+  if (_dataRefInfo[handle].dataRefRWType == XPL_WRITE)
+  { // never updated by xplane
+    return -1;
+  }
+  _dataRefInfo[handle].callback = callback;
+  return 0;
+}
+
+void XPLDirect::_dataRefReceived(int i)
+{
+  _dataRefs[i].updatedFlag = true;
+  _datarefsUpdatedFlag = true;
+  _changedSet[i >> 3] |= 1 << (i & 7);
+  _changedAny = true;
+  if (_dataRefInfo[i].callback != NULL)
+  {
+    _dataRefInfo[i].callback(i);
+  }
+}
+
 int XPLDirect::datarefsUpdated()
 {
   if (_datarefsUpdatedFlag)
@@ -205,53 +451,303 @@ void XPLDirect::sendResetRequest()
   }
 }
 
+// Incremental receiver, consumes whatever is available and keeps partial frames between calls
 void XPLDirect::_processSerial()
 {
-  while (streamPtr->available() && _receiveBuffer[0] != XPLDIRECT_PACKETHEADER)
+  if (streamPtr->available())
+  {
+    _lastReceiveTime = millis();
+  }
+  while (streamPtr->available())
+  {
+    char c = (char)streamPtr->read();
+#if XPLDIRECT_STATISTICS
+    _rxWireBytes++;
+#endif
+#if XPLDIRECT_BINARY_PROTOCOL
+    if (_binaryMode)
+    {
+      _receiveBinary(c);
+      continue;
+    }
+#endif
+    switch (_receiveState)
+    {
+    case XPL_RX_IDLE: // wait for frame header, skip anything else
+      if (c == XPLDIRECT_PACKETHEADER)
+      {
+        _receiveBuffer[0] = c;
+        _receiveBufferBytesReceived = 1;
+        _receiveState = XPL_RX_FRAME;
+      }
+      break;
+
+    case XPL_RX_FRAME:
+      if (c == XPLDIRECT_PACKETTRAILER)
+      {
+        _receiveState = XPL_RX_IDLE;
+        if (_receiveBufferBytesReceived < 2)
+        { // empty frame
+          _rxMalformedFrames++;
+          break;
+        }
+        _receiveBuffer[_receiveBufferBytesReceived++] = c;
+        _receiveBuffer[_receiveBufferBytesReceived] = 0; // old habits die hard.
+        _processPacket();
+      }
+      else if (_receiveBufferBytesReceived >= XPLMAX_PACKETSIZE - 2)
+      { // no space left for trailer and terminator, drop rest of the frame
+        _rxOversizeFrames++;
+        _receiveState = XPL_RX_DISCARD;
+      }
+      else
+      {
+        _receiveBuffer[_receiveBufferBytesReceived++] = c;
+      }
+      break;
+
+    case XPL_RX_DISCARD: // skip until end of oversized frame
+      if (c == XPLDIRECT_PACKETTRAILER)
+      {
+        _receiveState = XPL_RX_IDLE;
+      }
+      break;
+    }
+  }
+  // drop incomplete frames when the sender went silent
+  if (_receiveState != XPL_RX_IDLE && millis() - _lastReceiveTime > XPLDIRECT_RX_TIMEOUT)
   {
-    _receiveBuffer[0] = (char)streamPtr->read();
+    _receiveState = XPL_RX_IDLE;
+#if XPLDIRECT_BINARY_PROTOCOL
+    // binary mode stays across pauses, only a restarted plugin asking for the name in text leaves it. That
+    // request never gets a frame delimiter, so it is found here at the end of the incomplete frame.
+    int n = _receiveBufferBytesReceived;
+    if (_binaryMode && n >= 4 && _receiveBuffer[n - 3] == XPLDIRECT_PACKETHEADER &&
+        _receiveBuffer[n - 2] == XPLCMD_SENDNAME && _receiveBuffer[n - 1] == XPLDIRECT_PACKETTRAILER)
+    {
+      _binaryMode = false;
+      memmove(_receiveBuffer, &_receiveBuffer[n - 3], 3);
+      _receiveBuffer[3] = 0;
+      _receiveBufferBytesReceived = 3;
+      _processPacket();
+      return;
+    }
+#endif
+    _rxMalformedFrames++;
   }
-  if (_receiveBuffer[0] != XPLDIRECT_PACKETHEADER)
+}
+
+#if XPLDIRECT_BINARY_PROTOCOL
+#define XPL_BINARY_MAX_HANDLE 0x7FFF // largest handle held by an int on every board, varints carry up to 21 bits
+
+// Binary frames are COBS encoded and delimited by 0x00: command, handle as varint, payload
+void XPLDirect::_receiveBinary(char c)
+{
+  if (c != 0)
   {
+    if (_receiveState == XPL_RX_IDLE)
+    {
+      _receiveBufferBytesReceived = 1;
+      _receiveState = XPL_RX_FRAME;
+    }
+    if (_receiveState == XPL_RX_FRAME)
+    {
+      if (_receiveBufferBytesReceived >= XPLMAX_PACKETSIZE - 5)
+      { // keep space for moving the payload and adding trailer and terminator
+        _rxOversizeFrames++;
+        _receiveState = XPL_RX_DISCARD;
+      }
+      else
+      {
+        _receiveBuffer[_receiveBufferBytesReceived++] = c;
+      }
+    }
+    return;
+  }
+  // frame delimiter
+  if (_receiveState != XPL_RX_FRAME)
+  { // empty frames are used as padding
+    _receiveState = XPL_RX_IDLE;
     return;
   }
-  _receiveBufferBytesReceived = streamPtr->readBytesUntil(XPLDIRECT_PACKETTRAILER, (char *)&_receiveBuffer[1], XPLMAX_PACKETSIZE - 1);
-  if (_receiveBufferBytesReceived == 0)
+  _receiveState = XPL_RX_IDLE;
+  int length = _cobsDecode((byte *)&_receiveBuffer[1], _receiveBufferBytesReceived - 1);
+  int handleLength = (length > 1) ? _varintDecode((byte *)&_receiveBuffer[2], length - 1, &_binaryHandle) : 0;
+  if (handleLength <= 0 || handleLength > 3)
   {
-    _receiveBuffer[0] = 0;
+    _rxMalformedFrames++;
     return;
   }
-  _receiveBuffer[++_receiveBufferBytesReceived] = XPLDIRECT_PACKETTRAILER;
-  _receiveBuffer[++_receiveBufferBytesReceived] = 0; // old habits die hard.
+  // move payload to the same offset as in text frames
+  int payloadLength = length - 1 - handleLength;
+  memmove(&_receiveBuffer[5], &_receiveBuffer[2 + handleLength], payloadLength);
+  _receiveBufferBytesReceived = 5 + payloadLength;
+  _receiveBuffer[_receiveBufferBytesReceived++] = XPLDIRECT_PACKETTRAILER;
+  _receiveBuffer[_receiveBufferBytesReceived] = 0;
   _processPacket();
-  _receiveBuffer[0] = 0;
 }
 
+// in place decoding, returns decoded length or -1 on error
+int XPLDirect::_cobsDecode(byte *buffer, int length)
+{
+  int read = 0;
+  int write = 0;
+  while (read < length)
+  {
+    byte code = buffer[read++];
+    if (code == 0 || read + code - 1 > length)
+    {
+      return -1;
+    }
+    for (byte i = 1; i < code; i++)
+    {
+      buffer[write++] = buffer[read++];
+    }
+    if (code < 0xFF && read < length)
+    {
+      buffer[write++] = 0;
+    }
+  }
+  return write;
+}
+
+// in place encoding of buffer[1..length] into buffer[0..length], returns encoded length
+int XPLDirect::_cobsEncode(byte *buffer, int length)
+{
+  int codePos = 0;
+  int write = 1;
+  byte code = 1;
+  for (int read = 1; read <= length; read++)
+  {
+    if (buffer[read] == 0)
+    {
+      buffer[codePos] = code;
+      codePos = write++;
+      code = 1;
+    }
+    else
+    {
+      buffer[write++] = buffer[read];
+      code++;
+    }
+  }
+  buffer[codePos] = code;
+  return write;
+}
+
+// returns the number of bytes used, -1 for broken varints and handles that do not fit into an int on AVR
+int XPLDirect::_varintDecode(const byte *buffer, int length, int *value)
+{
+  unsigned long decoded = 0;
+  for (int i = 0; i < length && i < 3; i++)
+  {
+    decoded |= (unsigned long)(buffer[i] & 0x7F) << (7 * i);
+    if (!(buffer[i] & 0x80))
+    {
+      if (decoded > XPL_BINARY_MAX_HANDLE)
+      {
+        return -1;
+      }
+      *value = (int)decoded;
+      return i + 1;
+    }
+  }
+  return -1;
+}
+
+void XPLDirect::_binaryBegin(int command, int handle)
+{
+  _sendBufferLength = 1; // leave space for in place COBS encoding
+  _sendBuffer[_sendBufferLength++] = command;
+  _binaryAppendVarint(handle);
+}
+
+void XPLDirect::_binaryAppendVarint(int value)
+{
+  do
+  {
+    _sendBuffer[_sendBufferLength++] = (value & 0x7F) | (value > 0x7F ? 0x80 : 0);
+    value >>= 7;
+  } while (value > 0);
+}
+
+void XPLDirect::_binaryAppend(const void *data, int length)
+{
+  length = min(length, XPLMAX_PACKETSIZE - 3 - _sendBufferLength); // space for COBS overhead and delimiter
+  memcpy(&_sendBuffer[_sendBufferLength], data, length);
+  _sendBufferLength += length;
+}
+
+void XPLDirect::_binaryAppendName(XPString_t *name)
+{
+  char c;
+  for (int n = 0; (c = _nameChar(name, n)) != 0 && _sendBufferLength < XPLMAX_PACKETSIZE - 3; n++)
+  {
+    _sendBuffer[_sendBufferLength++] = c;
+  }
+}
+
+void XPLDirect::_transmitBinary()
+{
+  char command = _sendBuffer[1];
+  bool priority = _isPriority(command);
+  int length = _cobsEncode((byte *)_sendBuffer, _sendBufferLength - 1);
+  _sendBuffer[length++] = 0;
+#if XPLDIRECT_STATISTICS
+  _txTraffic[_trafficType(command)].frames++;
+  _txTraffic[_trafficType(command)].bytes += length;
+#endif
+  _queueFrame(_sendBuffer, length, priority);
+}
+#endif
+
 void XPLDirect::_processPacket()
 {
   int i;
+#if XPLDIRECT_STATISTICS
+  _rxTraffic[_trafficType(_receiveBuffer[1])].frames++;
+  _rxTraffic[_trafficType(_receiveBuffer[1])].bytes += _rxWireBytes; // as received, with COBS overhead, padding and noise
+  _rxWireBytes = 0;
+#endif
 
   switch (_receiveBuffer[1])
   {
   case XPLCMD_RESET:
     _connectionStatus = false;
+    _capabilities = 0;
+    _binaryMode = false;
     break;
   
   case XPL_EXITING :         // MG 03/14/2023:  Added protocol code so the device will know if xplane has shut down normally.
     _connectionStatus = false;
+    _capabilities = 0;
+    _binaryMode = false;
     break;
 
   case XPLCMD_SENDNAME:
+    if (!_binaryMode)
+    { // text request, maybe from a legacy plugin after a capable one went away without 'x'.
+      // Extensions are only used again after a new XPLCMD_CAPABILITIES exchange.
+      _capabilities = 0;
+    }
+    _handshakeStart = millis();
     _sendname();
+    if (_registrationsDropped > 0)
+    { // shows up in the log of the plugin, the sketch runs without the dropped datarefs and commands
+      _sendPoolWarning();
+    }
     _connectionStatus = true;            // not considered active till you know my name
+    _allDataRefsRegistered = false;      // schedule is rebuilt when registration completes again
     for (i = 0; i < _dataRefsCount; i++) // also, if name was requested reset active datarefs and commands
     {
-      _dataRefs[i]->dataRefHandle = -1; //  invalid again until assigned by Xplane
+      _dataRefs[i].dataRefHandle = -1; //  invalid again until assigned by Xplane
     }
+    _clearHandleMap();
     for (i = 0; i < _commandsCount; i++)
     {
-      _commands[i]->commandHandle = -1;
+      _commands[i].commandHandle = -1;
     }
+    _clearRegisterPending(); // requests of the last connection are answered or lost
     break;
 
   case XPLCMD_SENDVERSION:
@@ -261,102 +757,182 @@ void XPLDirect::_processPacket()
   }
 
   case XPLRESPONSE_DATAREF:
+  {
+    unsigned int hash = _frameNameHash();
+    // pipelined responses only bind to outstanding requests, a late duplicate would take the next array
+    // element of the same name otherwise
+    bool pipelined = (_capabilities & XPL_CAP_PIPELINE) != 0;
     for (int i = 0; i < _dataRefsCount; i++)
-    {
-      if (strncmp_PF((char *)&_receiveBuffer[5], (uint_farptr_t)_dataRefs[i]->dataRefName, strlen_PF((uint_farptr_t)_dataRefs[i]->dataRefName)) == 0 && _dataRefs[i]->dataRefHandle == -1)
+    { // compare hash first, flash strings only on a hit
+      if (_dataRefInfo[i].nameHash == hash && _dataRefs[i].dataRefHandle == -1 && !_isBlockElement(i) &&
+          (_dataRefInfo[i].registerPending || !pipelined) && _frameNameMatches(_dataRefInfo[i].dataRefName))
       {
-        _dataRefs[i]->dataRefHandle = _getHandleFromFrame(); // parse the refhandle
-        _dataRefs[i]->updatedFlag = true;
+        _dataRefs[i].dataRefHandle = _getHandleFromFrame(); // parse the refhandle
+        _dataRefInfo[i].registerPending = false;
+        _dataRefs[i].updatedFlag = true;
+        if (_dataRefs[i].dataRefHandle >= 0 && _dataRefs[i].dataRefHandle < XPLDIRECT_MAXHANDLES && _dataRefInfo[i].dataRefRWType != XPL_WRITE)
+        {
+          _handleMap[_dataRefs[i].dataRefHandle] = i;
+        }
+        for (int e = 1; e < _dataRefInfo[i].arrayCount && _isBlockElement(i + e); e++)
+        { // block elements share the handle of the block
+          _dataRefs[i + e].dataRefHandle = _dataRefs[i].dataRefHandle;
+        }
         i = _dataRefsCount; // end checking
       }
     }
     break;
+  }
 
   case XPLRESPONSE_COMMAND:
+  {
+    unsigned int hash = _frameNameHash();
     for (int i = 0; i < _commandsCount; i++)
     {
-      if (strncmp_PF((char *)&_receiveBuffer[5], (uint_farptr_t)_commands[i]->commandName, strlen_PF((uint_farptr_t)_commands[i]->commandName)) == 0 && _commands[i]->commandHandle == -1)
+      if (_commands[i].nameHash == hash && _commands[i].commandHandle == -1 && _frameNameMatches(_commands[i].commandName))
       {
-        _commands[i]->commandHandle = _getHandleFromFrame(); // parse the refhandle
+        _commands[i].commandHandle = _getHandleFromFrame(); // parse the refhandle
+        _commands[i].registerPending = false;
         i = _commandsCount;                                  // end checking
       }
     }
     break;
+  }
 
   case XPLCMD_SENDREQUEST:
   {
-    int packetSent = 0;
-    int i = 0;
-    while (!packetSent && i < _dataRefsCount && i < XPLDIRECT_MAXDATAREFS_ARDUINO) // send dataref registrations first
+    // legacy plugins get one registration per poll, capable plugins a window of them
+    int window = (_capabilities & XPL_CAP_PIPELINE) ? XPLDIRECT_REGISTER_WINDOW : 1;
+    int packetsSent = 0;
+    int pending = 0;
+    for (i = 0; packetsSent < window && i < _dataRefsCount; i++) // send dataref registrations first
     {
-      if (_dataRefs[i]->dataRefHandle == -1)
-      { // some boards cant do sprintf with floats so this is a workaround
-        sprintf(_sendBuffer, "%c%c%1.1i%2.2i%05i.%02i%S%c", XPLDIRECT_PACKETHEADER, XPLREQUEST_REGISTERDATAREF, _dataRefs[i]->dataRefRWType, _dataRefs[i]->arrayIndex,
-                (int)_dataRefs[i]->divider, (int)(_dataRefs[i]->divider * 100) % 100, (wchar_t *)_dataRefs[i]->dataRefName, XPLDIRECT_PACKETTRAILER);
-        _transmitPacket();
-        packetSent = 1;
+      if (_dataRefs[i].dataRefHandle == -1 && !_isBlockElement(i))
+      {
+        if (_dataRefInfo[i].registerPending || (window > 1 && _namePending(i)))
+        { // responses carry no array index, one request per name is outstanding at a time
+          pending++;
+          continue;
+        }
+        _sendRegisterDataRef(i);
+        _dataRefInfo[i].registerPending = (window > 1);
+        packetsSent++;
       }
-      i++;
     }
-    i = 0;
-    while (!packetSent && i < _commandsCount && i < XPLDIRECT_MAXCOMMANDS_ARDUINO) // now send command registrations
+    for (i = 0; packetsSent < window && i < _commandsCount; i++) // now send command registrations
     {
-      if (_commands[i]->commandHandle == -1)
+      if (_commands[i].commandHandle == -1)
+      {
+        if (_commands[i].registerPending)
+        {
+          pending++;
+          continue;
+        }
+        _sendRegisterCommand(i);
+        _commands[i].registerPending = (window > 1);
+        packetsSent++;
+      }
+    }
+    if (!packetsSent && pending)
+    { // still waiting for responses, request again if they seem to be lost
+      if (++_registerPolls >= XPLDIRECT_REGISTER_RETRY)
       {
-        sprintf(_sendBuffer, "%c%c%S%c", XPLDIRECT_PACKETHEADER, XPLREQUEST_REGISTERCOMMAND, (wchar_t *)_commands[i]->commandName, XPLDIRECT_PACKETTRAILER);
-        _transmitPacket();
-        packetSent = 1;
+        _clearRegisterPending();
       }
-      i++;
     }
-    if (!packetSent)
+    else
     {
-      _allDataRefsRegistered = true;
-      sprintf(_sendBuffer, "%c%c%c", XPLDIRECT_PACKETHEADER, XPLREQUEST_NOREQUESTS, XPLDIRECT_PACKETTRAILER);
+      _registerPolls = 0;
+    }
+    if (!packetsSent)
+    { // every poll gets an answer
+      if (!pending && !_allDataRefsRegistered)
+      {
+        _allDataRefsRegistered = true;
+        _handshakeTime = millis() - _handshakeStart;
+        _rebuildSchedule();
+      }
+#if XPLDIRECT_BINARY_PROTOCOL
+      if (_binaryMode)
+      {
+        _binaryBegin(XPLREQUEST_NOREQUESTS, 0);
+        _transmitBinary();
+        break;
+      }
+#endif
+      _frameBegin(XPLREQUEST_NOREQUESTS);
       _transmitPacket();
     }
     break;
   }
 
+  case XPLCMD_CAPABILITIES: // plugin offers protocol extensions, accept the ones we know
+  {
+    long int capabilities;
+    _getPayloadFromFrame(&capabilities);
+    _capabilities = capabilities & XPLDIRECT_CAPABILITIES;
+    _sendPacketInt(XPLCMD_CAPABILITIES, 0, _capabilities);
+    _binaryMode = (_capabilities & XPL_CAP_BINARY) != 0; // switch framing after the answer
+    break;
+  }
+
   case XPLCMD_DATAREFUPDATE:
   {
-    int refhandle = _getHandleFromFrame();
-    for (int i = 0; i < _dataRefsCount; i++)
+    int i = _findDataRef(_getHandleFromFrame());
+    if (i < 0)
+    { // not registered (any more)
+      _rxDroppedFrames++;
+    }
+    else
     {
-      if (_dataRefs[i]->dataRefHandle == refhandle && (_dataRefs[i]->dataRefRWType == XPL_READ || _dataRefs[i]->dataRefRWType == XPL_READWRITE))
+      if (_dataRefInfo[i].arrayCount > 1 && (_capabilities & XPL_CAP_ARRAYBLOCK))
+      { // should not happen, block is updated with XPLCMD_DATAREFUPDATEARRAY
+        break;
+      }
+      if (_dataRefs[i].dataRefVARType == XPL_DATATYPE_INT)
       {
-        if (_dataRefs[i]->dataRefVARType == XPL_DATATYPE_INT)
-        {
-          _getPayloadFromFrame((long int *)_dataRefs[i]->latestValue);
-          _dataRefs[i]->lastSentIntValue = *(long int *)_dataRefs[i]->latestValue;
-          _dataRefs[i]->updatedFlag = true;
-          _datarefsUpdatedFlag = true;
-        }
-        if (_dataRefs[i]->dataRefVARType == XPL_DATATYPE_FLOAT)
-        {
-          _getPayloadFromFrame((float *)_dataRefs[i]->latestValue);
-          _dataRefs[i]->lastSentFloatValue = *(float *)_dataRefs[i]->latestValue;
-          _dataRefs[i]->updatedFlag = true;
-          _datarefsUpdatedFlag = true;
-        }
-        if (_dataRefs[i]->dataRefVARType == XPL_DATATYPE_STRING)
-        {
-          _getPayloadFromFrame((char *)_dataRefs[i]->latestValue);
-          _dataRefs[i]->updatedFlag = true;
-          _datarefsUpdatedFlag = true;
-        }
-        i = _dataRefsCount; // skip the rest
+        _getPayloadFromFrame((long int *)_dataRefs[i].latestValue);
+        _dataRefs[i].lastSentIntValue = *(long int *)_dataRefs[i].latestValue;
+      }
+      if (_dataRefs[i].dataRefVARType == XPL_DATATYPE_FLOAT)
+      {
+        _getPayloadFromFrame((float *)_dataRefs[i].latestValue);
+        _dataRefs[i].lastSentFloatValue = *(float *)_dataRefs[i].latestValue;
+      }
+      if (_dataRefs[i].dataRefVARType == XPL_DATATYPE_STRING)
+      {
+        _getPayloadFromFrame((char *)_dataRefs[i].latestValue);
       }
+      _dataRefReceived(i);
+    }
+    break;
+  }
+  case XPLCMD_DATAREFUPDATEARRAY:
+  {
+    int i = _findDataRef(_getHandleFromFrame());
+    if (i >= 0 && _dataRefInfo[i].arrayCount > 1)
+    {
+      _receiveArrayBlock(i);
+    }
+    else
+    {
+      _rxDroppedFrames++;
     }
     break;
   }
+
+  case XPLREQUEST_STATISTICS:
+    _sendStatistics(_getHandleFromFrame());
+    break;
+
   case XPLREQUEST_REFRESH:
-    for (int i = 0; i < _dataRefsCount; i++)
+    for (int w = 0; w < _writeRefsCount; w++)
     {
-      if (_dataRefs[i]->dataRefRWType == XPL_WRITE || _dataRefs[i]->dataRefRWType == XPL_READWRITE)
-      {
-        _dataRefs[i]->forceUpdate = 1; // bypass noise and timing filters
-      }
+      _dataRefs[_writeRefs[w]].forceUpdate = 1; // bypass noise and timing filters
+    }
+    if (_allDataRefsRegistered)
+    {
+      _rebuildSchedule();
     }
     break;
 
@@ -369,19 +945,40 @@ void XPLDirect::_sendPacketInt(int command, int handle, long int value) // for i
 {
   if (handle >= 0)
   {
-    sprintf(_sendBuffer, "%c%c%3.3i%ld%c", XPLDIRECT_PACKETHEADER, command, handle, value, XPLDIRECT_PACKETTRAILER);
+#if XPLDIRECT_BINARY_PROTOCOL
+    if (_binaryMode)
+    {
+      int32_t raw = value;
+      _binaryBegin(command, handle);
+      _binaryAppend(&raw, sizeof(raw));
+      _transmitBinary();
+      return;
+    }
+#endif
+    _frameBegin(command);
+    _frameDigits(handle, 3);
+    _frameNumber(value);
     _transmitPacket();
   }
 }
 
-void XPLDirect::_sendPacketFloat(int command, int handle, float value) // for floats
+void XPLDirect::_sendPacketFloat(int command, int handle, float value, byte decimals) // for floats
 {
   if (handle >= 0)
   {
-    // some boards cant do sprintf with floats so this is a workaround.
+#if XPLDIRECT_BINARY_PROTOCOL
+    if (_binaryMode)
+    {
+      _binaryBegin(command, handle);
+      _binaryAppend(&value, sizeof(value));
+      _transmitBinary();
+      return;
+    }
+#endif
     char tmp[16];
-    dtostrf(value, 8, 6, tmp);
-    sprintf(_sendBuffer, "%c%c%3.3i%s%c", XPLDIRECT_PACKETHEADER, command, handle, tmp, XPLDIRECT_PACKETTRAILER);
+    _frameBegin(command);
+    _frameDigits(handle, 3);
+    _frameAppend(tmp, _formatFloat(tmp, value, decimals));
     _transmitPacket();
   }
 }
@@ -390,28 +987,489 @@ void XPLDirect::_sendPacketVoid(int command, int handle) // just a command with
 {
   if (handle >= 0)
   {
-    sprintf(_sendBuffer, "%c%c%3.3i%c", XPLDIRECT_PACKETHEADER, command, handle, XPLDIRECT_PACKETTRAILER);
+#if XPLDIRECT_BINARY_PROTOCOL
+    if (_binaryMode)
+    {
+      _binaryBegin(command, handle);
+      _transmitBinary();
+      return;
+    }
+#endif
+    _frameBegin(command);
+    _frameDigits(handle, 3);
     _transmitPacket();
   }
 }
 
 void XPLDirect::_sendPacketString(int command, char *str) // for a string
 {
-  sprintf(_sendBuffer, "%c%c%s%c", XPLDIRECT_PACKETHEADER, command, str, XPLDIRECT_PACKETTRAILER);
+#if XPLDIRECT_BINARY_PROTOCOL
+  if (_binaryMode)
+  {
+    _binaryBegin(command, 0);
+    _binaryAppend(str, strlen(str));
+    _transmitBinary();
+    return;
+  }
+#endif
+  _frameBegin(command);
+  _frameAppend(str, strlen(str));
+  _transmitPacket();
+}
+
+// dataref updates from xloop() are collected into multi update frames when the plugin supports it
+void XPLDirect::_sendUpdate(int handle, long int value)
+{
+  if (!(_capabilities & XPL_CAP_MULTIUPDATE))
+  {
+    _sendPacketInt(XPLCMD_DATAREFUPDATE, handle, value);
+    return;
+  }
+#if XPLDIRECT_BINARY_PROTOCOL
+  if (_binaryMode)
+  {
+    int32_t raw = value;
+    _appendUpdate(handle, &raw, sizeof(raw));
+    return;
+  }
+#endif
+  char tmp[16];
+  ltoa(value, tmp, 10);
+  _appendUpdate(handle, tmp, strlen(tmp));
+}
+
+void XPLDirect::_sendUpdate(int handle, float value, byte decimals)
+{
+  if (!(_capabilities & XPL_CAP_MULTIUPDATE))
+  {
+    _sendPacketFloat(XPLCMD_DATAREFUPDATE, handle, value, decimals);
+    return;
+  }
+#if XPLDIRECT_BINARY_PROTOCOL
+  if (_binaryMode)
+  {
+    _appendUpdate(handle, &value, sizeof(value));
+    return;
+  }
+#endif
+  char tmp[16];
+  _appendUpdate(handle, tmp, _formatFloat(tmp, value, decimals));
+}
+
+void XPLDirect::_appendUpdate(int handle, const void *data, int length)
+{
+#if XPLDIRECT_BINARY_PROTOCOL
+  if (_binaryMode)
+  {
+    if (_multiUpdateCount > 0 && _sendBufferLength + 2 + length > XPLMAX_PACKETSIZE - 3)
+    {
+      _flushUpdates();
+    }
+    if (_multiUpdateCount == 0)
+    {
+      _binaryBegin(XPLCMD_DATAREFUPDATEMULTI, 0);
+    }
+    _binaryAppendVarint(handle);
+    _binaryAppend(data, length);
+    _multiUpdateCount++;
+    return;
+  }
+#endif
+  // entry is handle, value and separator, keep space for trailer and terminator
+  if (_multiUpdateCount > 0 && _sendBufferLength + 3 + length + 1 > XPLMAX_PACKETSIZE - 2)
+  {
+    _flushUpdates();
+  }
+  if (_multiUpdateCount == 0)
+  {
+    _frameBegin(XPLCMD_DATAREFUPDATEMULTI);
+  }
+  _frameDigits(handle, 3);
+  _frameAppend((const char *)data, length);
+  _frameAppend(XPLDIRECT_UPDATESEPARATOR);
+  _multiUpdateCount++;
+}
+
+void XPLDirect::_flushUpdates()
+{
+  if (_multiUpdateCount == 0)
+  {
+    return;
+  }
+  _multiUpdateCount = 0;
+#if XPLDIRECT_BINARY_PROTOCOL
+  if (_binaryMode)
+  {
+    _transmitBinary();
+    return;
+  }
+#endif
   _transmitPacket();
 }
 
+void XPLDirect::_sendRegisterDataRef(int i)
+{
+  bool block = _dataRefInfo[i].arrayCount > 1 && (_capabilities & XPL_CAP_ARRAYBLOCK);
+#if XPLDIRECT_BINARY_PROTOCOL
+  if (_binaryMode)
+  {
+    _binaryBegin(block ? XPLREQUEST_REGISTERARRAY : XPLREQUEST_REGISTERDATAREF, 0);
+    _binaryAppend(&_dataRefInfo[i].dataRefRWType, 1);
+    _binaryAppend(&_dataRefInfo[i].arrayIndex, 1);
+    if (block)
+    {
+      _binaryAppend(&_dataRefInfo[i].arrayCount, 1);
+    }
+    _binaryAppend(&_dataRefs[i].divider, sizeof(float));
+    _binaryAppendName(_dataRefInfo[i].dataRefName);
+    _transmitBinary();
+    return;
+  }
+#endif
+  // RWMode, array index, number of elements for blocks, divider with two decimals, name
+  _frameBegin(block ? XPLREQUEST_REGISTERARRAY : XPLREQUEST_REGISTERDATAREF);
+  _frameDigits(_dataRefInfo[i].dataRefRWType, 1);
+  _frameDigits(_dataRefInfo[i].arrayIndex, 2);
+  if (block)
+  {
+    _frameDigits(_dataRefInfo[i].arrayCount, 2);
+  }
+  _frameDigits((int)_dataRefs[i].divider, 5);
+  _frameAppend('.');
+  _frameDigits((int)(_dataRefs[i].divider * 100) % 100, 2);
+  _frameName(_dataRefInfo[i].dataRefName);
+  _transmitPacket();
+}
+
+void XPLDirect::_sendRegisterCommand(int i)
+{
+#if XPLDIRECT_BINARY_PROTOCOL
+  if (_binaryMode)
+  {
+    _binaryBegin(XPLREQUEST_REGISTERCOMMAND, 0);
+    _binaryAppendName(_commands[i].commandName);
+    _transmitBinary();
+    return;
+  }
+#endif
+  _frameBegin(XPLREQUEST_REGISTERCOMMAND);
+  _frameName(_commands[i].commandName);
+  _transmitPacket();
+}
+
+// an earlier dataref of the same name, e.g. another element of the array, waits for its response
+bool XPLDirect::_namePending(int i)
+{
+  for (int j = 0; j < i; j++)
+  {
+    if (_dataRefInfo[j].registerPending && _dataRefInfo[j].nameHash == _dataRefInfo[i].nameHash &&
+        _nameEquals(_dataRefInfo[j].dataRefName, _dataRefInfo[i].dataRefName))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool XPLDirect::_nameEquals(XPString_t *a, XPString_t *b)
+{
+  char c;
+  int n = 0;
+  do
+  {
+    c = _nameChar(a, n);
+    if (c != _nameChar(b, n++))
+    {
+      return false;
+    }
+  } while (c != 0);
+  return true;
+}
+
+void XPLDirect::_clearRegisterPending()
+{
+  for (int i = 0; i < _dataRefsCount; i++)
+  {
+    _dataRefInfo[i].registerPending = false;
+  }
+  for (int i = 0; i < _commandsCount; i++)
+  {
+    _commands[i].registerPending = false;
+  }
+  _registerPolls = 0;
+}
+
+// Text frame builder, appends directly to _sendBuffer and keeps space for trailer and terminator
+void XPLDirect::_frameBegin(char command)
+{
+  _sendBuffer[0] = XPLDIRECT_PACKETHEADER;
+  _sendBuffer[1] = command;
+  _sendBufferLength = 2;
+}
+
+void XPLDirect::_frameAppend(char c)
+{
+  if (_sendBufferLength < XPLMAX_PACKETSIZE - 2)
+  {
+    _sendBuffer[_sendBufferLength++] = c;
+  }
+}
+
+void XPLDirect::_frameAppend(const char *data, int length)
+{
+  length = min(length, XPLMAX_PACKETSIZE - 2 - _sendBufferLength);
+  memcpy(&_sendBuffer[_sendBufferLength], data, length);
+  _sendBufferLength += length;
+}
+
+// zero padded to at least digits including the sign, like %0*i
+void XPLDirect::_frameDigits(int value, byte digits)
+{
+  unsigned int magnitude = value;
+  if (value < 0)
+  {
+    _frameAppend('-');
+    magnitude = 0U - magnitude;
+    if (digits > 0)
+    {
+      digits--;
+    }
+  }
+  char tmp[10]; // digits of UINT_MAX on 32 bit boards
+  byte length = 0;
+  do
+  {
+    tmp[length++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0);
+  while (digits > length)
+  {
+    _frameAppend('0');
+    digits--;
+  }
+  while (length > 0)
+  {
+    _frameAppend(tmp[--length]);
+  }
+}
+
+void XPLDirect::_frameNumber(long int value)
+{
+  char tmp[12];
+  ltoa(value, tmp, 10);
+  _frameAppend(tmp, strlen(tmp));
+}
+
+void XPLDirect::_frameName(XPString_t *name)
+{
+  char c;
+  for (int n = 0; (c = _nameChar(name, n)) != 0; n++)
+  {
+    _frameAppend(c);
+  }
+}
+
 void XPLDirect::_transmitPacket(void)
 {
-  streamPtr->write(_sendBuffer);
-  if (strlen(_sendBuffer) == 64)
+  _sendBuffer[_sendBufferLength++] = XPLDIRECT_PACKETTRAILER;
+  _sendBuffer[_sendBufferLength] = 0;
+  int length = _sendBufferLength;
+  bool priority = _isPriority(_sendBuffer[1]);
+#if XPLDIRECT_STATISTICS
+  _txTraffic[_trafficType(_sendBuffer[1])].frames++;
+  _txTraffic[_trafficType(_sendBuffer[1])].bytes += length;
+#endif
+  _queueFrame(_sendBuffer, length, priority);
+}
+
+bool XPLDirect::_isPriority(char command) // commands go ahead of dataref updates
+{
+  return command == XPLCMD_COMMANDSTART || command == XPLCMD_COMMANDEND || command == XPLCMD_COMMANDTRIGGER;
+}
+
+void XPLDirect::_queueFrame(const char *frame, int length, bool priority)
+{
+#if XPLDIRECT_TX_BUFFER > 0
+  _txLaneStructure *lane = priority ? &_txPriorityLane : &_txNormalLane;
+  if (lane->used + length + 1 > lane->size)
+  { // no space left, push out everything queued and wait for the stream
+    _txOverflows++;
+    _drainTx(true);
+    if ((unsigned int)length + 1 > lane->size)
+    {
+      _streamWrite((const byte *)frame, length);
+      return;
+    }
+  }
+  _txPush(lane, length);
+  for (int i = 0; i < length; i++)
+  {
+    _txPush(lane, frame[i]);
+  }
+#else
+  if (streamPtr->availableForWrite() < length)
+  { // the write blocks until the stream made room
+    _txOverflows++;
+  }
+  _streamWrite((const byte *)frame, length);
+#endif
+}
+
+// apparantly a bug on some boards when we transmit exactly 64 bytes. Only writes ending a frame may have
+// 64 bytes, they get a blank after text frames or an empty frame after binary ones as padding.
+void XPLDirect::_streamWrite(const byte *data, int length)
+{
+  streamPtr->write(data, length);
+  if (length == 64)
+  {
+    streamPtr->write(data[length - 1] == 0 ? (uint8_t)0 : (uint8_t)' ');
+  }
+}
+
+#if XPLDIRECT_TX_BUFFER > 0
+void XPLDirect::_txPush(_txLaneStructure *lane, byte data)
+{
+  lane->buffer[lane->head] = data;
+  if (++lane->head >= lane->size)
+  {
+    lane->head = 0;
+  }
+  lane->used++;
+}
+
+byte XPLDirect::_txPop(_txLaneStructure *lane)
+{
+  byte data = lane->buffer[lane->tail];
+  if (++lane->tail >= lane->size)
+  {
+    lane->tail = 0;
+  }
+  lane->used--;
+  return data;
+}
+
+// write queued frames as far as the stream accepts without blocking, or all of them if requested
+void XPLDirect::_drainTx(bool all)
+{
+  int space = all ? 0x7FFF : streamPtr->availableForWrite();
+  while (space > 0)
+  {
+    if (_txFrameRemaining == 0)
+    { // next frame, priority lane first
+      if (_txPriorityLane.used)
+      {
+        _txLane = &_txPriorityLane;
+      }
+      else if (_txNormalLane.used)
+      {
+        _txLane = &_txNormalLane;
+      }
+      else
+      {
+        return;
+      }
+      _txFrameRemaining = _txPop(_txLane);
+    }
+    // write up to the end of the frame or the wrap around of the buffer
+    int length = min(space, min(_txFrameRemaining, (int)(_txLane->size - _txLane->tail)));
+    if (length == 64 && length < _txFrameRemaining)
+    { // padding only fits between frames
+      length--;
+    }
+    _streamWrite(&_txLane->buffer[_txLane->tail], length);
+    _txLane->tail = (_txLane->tail + length) % _txLane->size;
+    _txLane->used -= length;
+    _txFrameRemaining -= length;
+    space -= length;
+  }
+}
+#endif
+
+unsigned int XPLDirect::txOverflows()
+{
+  return _txOverflows;
+}
+
+void XPLDirect::_clearHandleMap()
+{
+  for (int i = 0; i < XPLDIRECT_MAXHANDLES; i++)
+  {
+    _handleMap[i] = XPL_NO_INDEX;
+  }
+}
+
+int XPLDirect::_findDataRef(int handle) // local index of readable dataref for handle assigned by xplane, -1 if unknown
+{
+  if (handle >= 0 && handle < XPLDIRECT_MAXHANDLES)
+  {
+    return (_handleMap[handle] == XPL_NO_INDEX) ? -1 : _handleMap[handle];
+  }
+  for (int r = 0; r < _readRefsCount; r++) // handles beyond the table are looked up the slow way
+  {
+    if (_dataRefs[_readRefs[r]].dataRefHandle == handle)
+    {
+      return _readRefs[r];
+    }
+  }
+  return -1;
+}
+
+// FNV-1a hash folded to 16 bit, used to avoid flash string compares on registration responses
+#define XPL_HASH_INIT 0x811C
+#define XPL_HASH_STEP(hash, c) (((hash) ^ (byte)(c)) * 0x0193)
+
+unsigned int XPLDirect::_nameHash(XPString_t *name)
+{
+  unsigned int hash = XPL_HASH_INIT;
+  char c;
+  for (int n = 0; (c = _nameChar(name, n)) != 0; n++)
+  {
+    hash = XPL_HASH_STEP(hash, c);
+  }
+  return hash & 0xFFFF;
+}
+
+unsigned int XPLDirect::_frameNameHash() // Assuming receive buffer is holding a good frame
+{
+  unsigned int hash = XPL_HASH_INIT;
+  for (int i = 5; i < _receiveBufferBytesReceived - 1; i++) // name ends before the packet trailer
+  {
+    hash = XPL_HASH_STEP(hash, _receiveBuffer[i]);
+  }
+  return hash & 0xFFFF;
+}
+
+bool XPLDirect::_frameNameMatches(XPString_t *name) // Assuming receive buffer is holding a good frame
+{
+  int length = _receiveBufferBytesReceived - 6; // name ends before the packet trailer
+  for (int n = 0; n < length; n++)
   {
-    streamPtr->print(" "); // apparantly a bug on some boards when we transmit exactly 64 bytes
+    if (_nameChar(name, n) != _receiveBuffer[5 + n])
+    {
+      return false;
+    }
   }
+  return _nameChar(name, length) == 0;
+}
+
+// names are in flash with XPL_USE_PROGMEM, otherwise in RAM. All name access goes through here.
+char XPLDirect::_nameChar(XPString_t *name, int n)
+{
+#if XPL_USE_PROGMEM
+  return pgm_read_byte((const char *)name + n);
+#else
+  return name[n];
+#endif
 }
 
 int XPLDirect::_getHandleFromFrame() // Assuming receive buffer is holding a good frame
 {
+#if XPLDIRECT_BINARY_PROTOCOL
+  if (_binaryMode)
+  {
+    return _binaryHandle;
+  }
+#endif
   char holdChar;
   int handleRet;
   holdChar = _receiveBuffer[5];
@@ -423,6 +1481,15 @@ int XPLDirect::_getHandleFromFrame() // Assuming receive buffer is holding a goo
 
 int XPLDirect::_getPayloadFromFrame(long int *value) // Assuming receive buffer is holding a good frame
 {
+#if XPLDIRECT_BINARY_PROTOCOL
+  if (_binaryMode)
+  {
+    int32_t raw = 0;
+    memcpy(&raw, &_receiveBuffer[5], min(_receiveBufferBytesReceived - 6, (int)sizeof(raw)));
+    *value = raw;
+    return 0;
+  }
+#endif
   char holdChar;
   holdChar = _receiveBuffer[15];
   _receiveBuffer[15] = 0;
@@ -433,19 +1500,205 @@ int XPLDirect::_getPayloadFromFrame(long int *value) // Assuming receive buffer
 
 int XPLDirect::_getPayloadFromFrame(float *value) // Assuming receive buffer is holding a good frame
 {
+#if XPLDIRECT_BINARY_PROTOCOL
+  if (_binaryMode)
+  {
+    *value = 0;
+    memcpy(value, &_receiveBuffer[5], min(_receiveBufferBytesReceived - 6, (int)sizeof(float)));
+    return 0;
+  }
+#endif
   char holdChar;
   holdChar = _receiveBuffer[15];
   _receiveBuffer[15] = 0;
-  *value = atof((char *)&_receiveBuffer[5]);
+  *value = _parseFloat((char *)&_receiveBuffer[5]);
   _receiveBuffer[15] = holdChar;
   return 0;
 }
 
+// Fixed point conversions without the libc float routines, which are slow on boards without FPU
+
+// number of decimals needed to represent multiples of divider, 6 without divider like dtostrf before
+byte XPLDirect::_dividerDecimals(float divider)
+{
+  if (divider <= 0)
+  {
+    return XPL_FLOAT_DECIMALS;
+  }
+  byte decimals = 0;
+  while (decimals < XPL_FLOAT_DECIMALS && fabs(divider - (long)(divider + 0.5)) > 0.001 * divider)
+  { // tolerance relative to the divider, absolute it would end the loop early for dividers below 0.001
+    divider *= 10;
+    decimals++;
+  }
+  return decimals;
+}
+
+// writes value with the fewest decimals, at most decimals, that read back as the same float. Without a round
+// trip within decimals (below 0.03 or a divider) the value is rounded to decimals. Returns length.
+#define XPL_FRACTION_ONE 0x10000000UL // fixed point fraction with 28 bits, exact for values from 2^-5 on
+int XPLDirect::_formatFloat(char *buffer, float value, byte decimals)
+{
+  if (!(fabs(value) < 4.0e9)) // also true for NaN
+  {
+    dtostrf(value, 1, decimals, buffer);
+    return strlen(buffer);
+  }
+  char *p = buffer;
+  bool negative = value < 0;
+  if (negative)
+  {
+    value = -value;
+  }
+  unsigned long integer = (unsigned long)value;
+  unsigned long rest = (unsigned long)((value - integer) * (float)XPL_FRACTION_ONE); // scaling by 2^28 is exact
+  // spacing of floats around value in fraction units, 0 when finer than the fraction
+  unsigned long ulp = 0;
+  if (integer >= 0x800000UL)
+  { // no fraction bits left
+    decimals = 0;
+  }
+  else if (integer > 0)
+  {
+    ulp = 32;
+    for (unsigned long i = integer; i > 1; i >>= 1)
+    {
+      ulp <<= 1;
+    }
+  }
+  else if (rest >= 0x800000UL)
+  {
+    for (ulp = 0x800000UL; ulp * 2 <= rest; ulp <<= 1)
+    {
+    }
+    ulp >>= 23;
+  }
+  if ((rest == 0 && (integer & (integer - 1)) == 0) || (integer == 0 && (rest & (rest - 1)) == 0))
+  { // powers of two have the next float below closer
+    ulp >>= 1;
+  }
+  // one digit after the other until the decimal is within half a float spacing of value
+  char digits[XPL_FLOAT_DECIMALS];
+  byte count = 0;
+  for (unsigned long tolerance = ulp;; tolerance = tolerance > 0x20000000UL / 10 ? 0x20000000UL : tolerance * 10)
+  {
+    bool up = rest >= XPL_FRACTION_ONE / 2;
+    unsigned long error = up ? XPL_FRACTION_ONE - rest : rest;
+    if (count >= decimals || count >= XPL_FLOAT_DECIMALS || 2 * error < tolerance)
+    {
+      if (up)
+      { // round, the carry may run into the integer part
+        int i = count - 1;
+        while (i >= 0 && digits[i] == 9)
+        {
+          digits[i--] = 0;
+        }
+        if (i < 0)
+        {
+          integer++;
+        }
+        else
+        {
+          digits[i]++;
+        }
+      }
+      break;
+    }
+    rest *= 10;
+    digits[count++] = rest / XPL_FRACTION_ONE;
+    rest %= XPL_FRACTION_ONE;
+  }
+  while (count > 0 && digits[count - 1] == 0)
+  {
+    count--;
+  }
+  if (negative && (integer > 0 || count > 0))
+  {
+    *p++ = '-';
+  }
+  ultoa(integer, p, 10);
+  p += strlen(p);
+  if (count > 0)
+  {
+    *p++ = '.';
+    for (byte i = 0; i < count; i++)
+    {
+      *p++ = '0' + digits[i];
+    }
+  }
+  *p = 0;
+  return p - buffer;
+}
+
+// parses [-]digits[.digits], falls back to atof for anything else. The same float as atof up to 7 significant
+// digits, at most 1 ulp off beyond.
+float XPLDirect::_parseFloat(const char *str)
+{
+  const char *p = str;
+  while (*p == ' ')
+  {
+    p++;
+  }
+  bool negative = (*p == '-');
+  if (*p == '-' || *p == '+')
+  {
+    p++;
+  }
+  unsigned long mantissa = 0;
+  unsigned long scale = 1;
+  bool fraction = false;
+  for (;; p++)
+  {
+    if (*p >= '0' && *p <= '9')
+    {
+      if (mantissa < 100000000UL)
+      {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (fraction)
+        {
+          scale *= 10;
+        }
+      }
+      else if (!fraction)
+      { // integer part too long for fixed point
+        return atof(str);
+      }
+    }
+    else if (*p == '.' && !fraction)
+    {
+      fraction = true;
+    }
+    else if (*p == 'e' || *p == 'E' || *p == 'n' || *p == 'N' || *p == 'i' || *p == 'I')
+    { // exponent, nan, inf
+      return atof(str);
+    }
+    else
+    {
+      break;
+    }
+  }
+  // one rounding while the mantissa fits into a float, else the fraction is rounded on its own
+  float value;
+  if (scale == 1 || mantissa < 0x1000000UL)
+  {
+    value = (scale > 1) ? (float)mantissa / (float)scale : (float)mantissa;
+  }
+  else if (mantissa / scale > 0 && mantissa / scale < 0x1000000UL)
+  {
+    value = (float)(mantissa / scale) + (float)(mantissa % scale) / (float)scale;
+  }
+  else
+  {
+    return atof(str);
+  }
+  return negative ? -value : value;
+}
+
 int XPLDirect::_getPayloadFromFrame(char *value) // Assuming receive buffer is holding a good frame
 {
   memcpy(value, (char *)&_receiveBuffer[5], _receiveBufferBytesReceived - 6);
   value[_receiveBufferBytesReceived - 6] = 0; // erase the packet trailer
-  for (int i = 0; i < _receiveBufferBytesReceived - 6; i++)
+  for (int i = 0; i < _receiveBufferBytesReceived - 6 && !_binaryMode; i++)
   {
     if (value[i] == 7)
     {
@@ -455,6 +1708,199 @@ int XPLDirect::_getPayloadFromFrame(char *value) // Assuming receive buffer is h
   return 0;
 }
 
+// values of an array block, starting at the offset given in the frame
+void XPLDirect::_receiveArrayBlock(int i)
+{
+  int length = _receiveBufferBytesReceived - 6; // payload
+  const char *p = (const char *)&_receiveBuffer[5];
+  int offset;
+#if XPLDIRECT_BINARY_PROTOCOL
+  if (_binaryMode)
+  {
+    offset = (length > 0) ? (byte)*p : -1;
+    if (offset < 0 || offset >= _dataRefInfo[i].arrayCount)
+    { // the block starts outside the array
+      _rxDroppedFrames++;
+      return;
+    }
+    p++;
+    length--;
+    for (int e = offset; e < _dataRefInfo[i].arrayCount && length >= 4; e++)
+    {
+      if (_dataRefs[i + e].dataRefVARType == XPL_DATATYPE_INT)
+      {
+        int32_t raw;
+        memcpy(&raw, p, sizeof(raw));
+        *(long int *)_dataRefs[i + e].latestValue = raw;
+      }
+      else
+      {
+        memcpy(_dataRefs[i + e].latestValue, p, sizeof(float));
+      }
+      _dataRefReceived(i + e);
+      p += 4;
+      length -= 4;
+    }
+    return;
+  }
+#endif
+  offset = -1;
+  if (length >= 2 && p[0] >= '0' && p[0] <= '9' && p[1] >= '0' && p[1] <= '9')
+  {
+    offset = (p[0] - '0') * 10 + (p[1] - '0');
+  }
+  if (offset < 0 || offset >= _dataRefInfo[i].arrayCount)
+  { // the block starts outside the array
+    _rxDroppedFrames++;
+    return;
+  }
+  p += 2;
+  const char *end = (const char *)&_receiveBuffer[_receiveBufferBytesReceived - 1]; // trailer
+  for (int e = offset; e < _dataRefInfo[i].arrayCount && p < end; e++)
+  {
+    if (_dataRefs[i + e].dataRefVARType == XPL_DATATYPE_INT)
+    {
+      *(long int *)_dataRefs[i + e].latestValue = atol(p);
+    }
+    else
+    {
+      *(float *)_dataRefs[i + e].latestValue = _parseFloat(p);
+    }
+    _dataRefReceived(i + e);
+    while (p < end && *p++ != XPLDIRECT_UPDATESEPARATOR)
+    {
+    }
+  }
+}
+
+unsigned int XPLDirect::rxDroppedFrames()
+{
+  return _rxDroppedFrames;
+}
+
+unsigned long XPLDirect::handshakeTime()
+{
+  return _handshakeTime;
+}
+
+#if XPLDIRECT_STATISTICS
+unsigned long XPLDirect::rxFrames(int type)
+{
+  return (type >= 0 && type < XPL_STAT_TYPES) ? _rxTraffic[type].frames : 0;
+}
+
+unsigned long XPLDirect::rxBytes(int type)
+{
+  return (type >= 0 && type < XPL_STAT_TYPES) ? _rxTraffic[type].bytes : 0;
+}
+
+unsigned long XPLDirect::txFrames(int type)
+{
+  return (type >= 0 && type < XPL_STAT_TYPES) ? _txTraffic[type].frames : 0;
+}
+
+unsigned long XPLDirect::txBytes(int type)
+{
+  return (type >= 0 && type < XPL_STAT_TYPES) ? _txTraffic[type].bytes : 0;
+}
+
+void XPLDirect::resetStatistics()
+{
+  memset(_rxTraffic, 0, sizeof(_rxTraffic));
+  memset(_txTraffic, 0, sizeof(_txTraffic));
+  _rxWireBytes = 0;
+}
+
+byte XPLDirect::_trafficType(char command)
+{
+  switch (command)
+  {
+  case XPLREQUEST_REGISTERDATAREF:
+  case XPLREQUEST_REGISTERARRAY:
+  case XPLREQUEST_REGISTERCOMMAND:
+  case XPLREQUEST_NOREQUESTS:
+  case XPLRESPONSE_DATAREF:
+  case XPLRESPONSE_COMMAND:
+  case XPLCMD_SENDREQUEST:
+    return XPL_STAT_REGISTER;
+  case XPLCMD_DATAREFUPDATE:
+  case XPLCMD_DATAREFUPDATEMULTI:
+  case XPLCMD_DATAREFUPDATEARRAY:
+    return XPL_STAT_UPDATE;
+  case XPLCMD_COMMANDSTART:
+  case XPLCMD_COMMANDEND:
+  case XPLCMD_COMMANDTRIGGER:
+    return XPL_STAT_COMMAND;
+  case XPLCMD_PRINTDEBUG:
+  case XPLCMD_SPEAK:
+    return XPL_STAT_MESSAGE;
+  default:
+    return XPL_STAT_CONTROL;
+  }
+}
+#endif
+
+// answer to XPLREQUEST_STATISTICS, counters of one traffic type or the error counters
+void XPLDirect::_sendStatistics(int type)
+{
+  unsigned long values[5];
+  int count = 0;
+  if (type == XPL_STAT_TYPES)
+  {
+    values[count++] = _rxMalformedFrames;
+    values[count++] = _rxOversizeFrames;
+    values[count++] = _rxDroppedFrames;
+    values[count++] = _txOverflows;
+    values[count++] = _handshakeTime;
+  }
+#if XPLDIRECT_STATISTICS
+  else if (type >= 0 && type < XPL_STAT_TYPES)
+  {
+    values[count++] = _rxTraffic[type].frames;
+    values[count++] = _rxTraffic[type].bytes;
+    values[count++] = _txTraffic[type].frames;
+    values[count++] = _txTraffic[type].bytes;
+  }
+#endif
+  char tmp[XPLMAX_PACKETSIZE - 5];
+  int length = 0;
+  tmp[length++] = '0' + (type / 100) % 10;
+  tmp[length++] = '0' + (type / 10) % 10;
+  tmp[length++] = '0' + type % 10;
+  for (int v = 0; v < count; v++)
+  {
+    ultoa(values[v], &tmp[length], 10);
+    length += strlen(&tmp[length]);
+    tmp[length++] = XPLDIRECT_UPDATESEPARATOR;
+  }
+  tmp[length] = 0;
+  _sendPacketString(XPLRESPONSE_STATISTICS, tmp);
+}
+
+unsigned int XPLDirect::registrationsDropped()
+{
+  return _registrationsDropped;
+}
+
+// debug message to the plugin when registrations did not fit into the pools
+void XPLDirect::_sendPoolWarning()
+{
+  char tmp[48];
+  strcpy(tmp, "XPLDirect pools full, dropped: ");
+  ultoa(_registrationsDropped, &tmp[strlen(tmp)], 10);
+  sendDebugMessage(tmp);
+}
+
+unsigned int XPLDirect::rxMalformedFrames()
+{
+  return _rxMalformedFrames;
+}
+
+unsigned int XPLDirect::rxOversizeFrames()
+{
+  return _rxOversizeFrames;
+}
+
 int XPLDirect::allDataRefsRegistered()
 {
   return _allDataRefsRegistered;
@@ -462,116 +1908,149 @@ int XPLDirect::allDataRefsRegistered()
 
 int XPLDirect::registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, long int *value)
 {
-  if (_dataRefsCount >= XPLDIRECT_MAXDATAREFS_ARDUINO)
+  int i = _addDataRef(datarefName, rwmode, rate, divider, (void *)value, XPL_DATATYPE_INT, 0);
+  if (i >= 0)
   {
-    return -1; // Error
+    _dataRefs[i].lastSentIntValue = 0;
   }
-  _dataRefs[_dataRefsCount] = new _dataRefStructure;
-  _dataRefs[_dataRefsCount]->dataRefName = datarefName; // added for F() macro
-  _dataRefs[_dataRefsCount]->dataRefRWType = rwmode;
-  _dataRefs[_dataRefsCount]->divider = divider;
-  _dataRefs[_dataRefsCount]->updateRate = rate;
-  _dataRefs[_dataRefsCount]->dataRefVARType = XPL_DATATYPE_INT;
-  _dataRefs[_dataRefsCount]->latestValue = (void *)value;
-  _dataRefs[_dataRefsCount]->lastSentIntValue = 0;
-  _dataRefs[_dataRefsCount]->arrayIndex = 0;     // not used unless we are referencing an array
-  _dataRefs[_dataRefsCount]->dataRefHandle = -1; // invalid until assigned by xplane
-  _dataRefsCount++;
-  _allDataRefsRegistered = 0;
-  return (_dataRefsCount - 1);
+  return i;
 }
 
 int XPLDirect::registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, long int *value, int index)
 {
-  if (_dataRefsCount >= XPLDIRECT_MAXDATAREFS_ARDUINO)
+  int i = _addDataRef(datarefName, rwmode, rate, divider, (void *)value, XPL_DATATYPE_INT, index); // arrays are dealt with on the XPlane plugin side
+  if (i >= 0)
   {
-    return -1;
+    _dataRefs[i].lastSentIntValue = 0;
   }
-  _dataRefs[_dataRefsCount] = new _dataRefStructure;
-  _dataRefs[_dataRefsCount]->dataRefName = datarefName;
-  _dataRefs[_dataRefsCount]->dataRefRWType = rwmode;
-  _dataRefs[_dataRefsCount]->updateRate = rate;
-  _dataRefs[_dataRefsCount]->divider = divider;
-  _dataRefs[_dataRefsCount]->dataRefVARType = XPL_DATATYPE_INT; // arrays are dealt with on the XPlane plugin side
-  _dataRefs[_dataRefsCount]->latestValue = (void *)value;
-  _dataRefs[_dataRefsCount]->lastSentIntValue = 0;
-  _dataRefs[_dataRefsCount]->arrayIndex = index; // not used unless we are referencing an array
-  _dataRefs[_dataRefsCount]->dataRefHandle = -1; // invalid until assigned by xplane
-  _dataRefsCount++;
-  _allDataRefsRegistered = 0;
-  return (_dataRefsCount - 1);
+  return i;
 }
 
 int XPLDirect::registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, float *value)
 {
-  if (_dataRefsCount >= XPLDIRECT_MAXDATAREFS_ARDUINO)
+  int i = _addDataRef(datarefName, rwmode, rate, divider, (void *)value, XPL_DATATYPE_FLOAT, 0);
+  if (i >= 0)
   {
-    return -1;
+    _dataRefs[i].lastSentFloatValue = -1; // force update on first loop
+    _dataRefs[i].forceUpdate = 1;         // no deadband around the placeholder before the first send
   }
-  _dataRefs[_dataRefsCount] = new _dataRefStructure;
-  _dataRefs[_dataRefsCount]->dataRefName = datarefName;
-  _dataRefs[_dataRefsCount]->dataRefRWType = rwmode;
-  _dataRefs[_dataRefsCount]->dataRefVARType = XPL_DATATYPE_FLOAT;
-  _dataRefs[_dataRefsCount]->latestValue = (void *)value;
-  _dataRefs[_dataRefsCount]->lastSentFloatValue = -1; // force update on first loop
-  _dataRefs[_dataRefsCount]->updateRate = rate;
-  _dataRefs[_dataRefsCount]->divider = divider;
-  _dataRefs[_dataRefsCount]->arrayIndex = 0;     // not used unless we are referencing an array
-  _dataRefs[_dataRefsCount]->dataRefHandle = -1; // invalid until assigned by xplane
-  _dataRefsCount++;
-  _allDataRefsRegistered = 0;
-  return (_dataRefsCount - 1);
+  return i;
 }
 
 int XPLDirect::registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, float *value, int index)
 {
-  if (_dataRefsCount >= XPLDIRECT_MAXDATAREFS_ARDUINO)
+  int i = _addDataRef(datarefName, rwmode, rate, divider, (void *)value, XPL_DATATYPE_FLOAT, index); // arrays are dealt with on the Xplane plugin side
+  if (i >= 0)
   {
-    return -1;
+    _dataRefs[i].lastSentFloatValue = 0;
+    _dataRefs[i].forceUpdate = 1; // no deadband around the placeholder before the first send
   }
-  _dataRefs[_dataRefsCount] = new _dataRefStructure;
-  _dataRefs[_dataRefsCount]->dataRefName = datarefName;
-  _dataRefs[_dataRefsCount]->dataRefRWType = rwmode;
-  _dataRefs[_dataRefsCount]->dataRefVARType = XPL_DATATYPE_FLOAT; // arrays are dealt with on the Xplane plugin side
-  _dataRefs[_dataRefsCount]->latestValue = (void *)value;
-  _dataRefs[_dataRefsCount]->lastSentFloatValue = 0;
-  _dataRefs[_dataRefsCount]->updateRate = rate;
-  _dataRefs[_dataRefsCount]->arrayIndex = index; // not used unless we are referencing an array
-  _dataRefs[_dataRefsCount]->dataRefHandle = -1; // invalid until assigned by xplane
-  _dataRefsCount++;
-  _allDataRefsRegistered = 0;
-  return (_dataRefsCount - 1);
+  return i;
 }
 
 int XPLDirect::registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, char *value)
 {
-  if (_dataRefsCount >= XPLDIRECT_MAXDATAREFS_ARDUINO)
+  int i = _addDataRef(datarefName, rwmode, rate, 0, (void *)value, XPL_DATATYPE_STRING, 0);
+  if (i >= 0)
   {
+    _dataRefs[i].lastSentIntValue = 0;
+  }
+  return i;
+}
+
+int XPLDirect::registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, long int *value, int index, int count)
+{
+  return _addDataRefBlock(datarefName, rwmode, rate, divider, (void *)value, XPL_DATATYPE_INT, index, count);
+}
+
+int XPLDirect::registerDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, float *value, int index, int count)
+{
+  return _addDataRefBlock(datarefName, rwmode, rate, divider, (void *)value, XPL_DATATYPE_FLOAT, index, count);
+}
+
+// array block in consecutive datarefs, so legacy plugins can register the elements one by one
+int XPLDirect::_addDataRefBlock(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, void *value, byte type, int index, int count)
+{
+  if (rwmode != XPL_READ || count < 1 || count > 99 || index < 0 || index + count > 100)
+  { // the text frames carry index and count in 2 digits
+    return -1; // Error
+  }
+  if (_dataRefsCount + count > XPLDIRECT_MAXDATAREFS_ARDUINO)
+  {
+    _registrationsDropped += count;
     return -1;
   }
-  _dataRefs[_dataRefsCount] = new _dataRefStructure;
-  _dataRefs[_dataRefsCount]->dataRefName = datarefName;
-  _dataRefs[_dataRefsCount]->dataRefRWType = rwmode;
-  _dataRefs[_dataRefsCount]->updateRate = rate;
-  _dataRefs[_dataRefsCount]->dataRefVARType = XPL_DATATYPE_STRING;
-  _dataRefs[_dataRefsCount]->latestValue = (void *)value;
-  _dataRefs[_dataRefsCount]->lastSentIntValue = 0;
-  _dataRefs[_dataRefsCount]->arrayIndex = 0;     // not used unless we are referencing an array
-  _dataRefs[_dataRefsCount]->dataRefHandle = -1; // invalid until assigned by xplane
+  int first = _dataRefsCount;
+  int size = (type == XPL_DATATYPE_INT) ? sizeof(long int) : sizeof(float);
+  for (int e = 0; e < count; e++)
+  {
+    _addDataRef(datarefName, rwmode, rate, divider, (byte *)value + e * size, type, index + e);
+    _dataRefInfo[first + e].arrayCount = 0;
+  }
+  _dataRefInfo[first].arrayCount = count;
+  return first;
+}
+
+// element of an array block that is registered as a whole
+bool XPLDirect::_isBlockElement(int i)
+{
+  return _dataRefInfo[i].arrayCount == 0 && (_capabilities & XPL_CAP_ARRAYBLOCK);
+}
+
+// common part of dataref registration, returns index or -1 when no space left
+int XPLDirect::_addDataRef(XPString_t *datarefName, int rwmode, unsigned int rate, float divider, void *value, byte type, int index)
+{
+  if (_dataRefsCount >= XPLDIRECT_MAXDATAREFS_ARDUINO)
+  {
+    _registrationsDropped++;
+    return -1; // Error
+  }
+  int i = _dataRefsCount;
+  _dataRefInfo[i].dataRefName = datarefName; // added for F() macro
+  _dataRefInfo[i].nameHash = _nameHash(datarefName);
+  _dataRefInfo[i].dataRefRWType = rwmode;
+  _dataRefInfo[i].arrayIndex = index; // not used unless we are referencing an array
+  _dataRefInfo[i].registerPending = false;
+  _dataRefInfo[i].callback = NULL;
+  _dataRefInfo[i].arrayCount = 1;
+  _dataRefs[i].dataRefHandle = -1; // invalid until assigned by xplane
+  _dataRefs[i].dataRefVARType = type;
+  _dataRefs[i].divider = divider;
+  _dataRefs[i].decimals = _dividerDecimals(divider);
+  _dataRefs[i].deadband = 0;
+  _dataRefs[i].deadbandRelative = 0;
+  _dataRefs[i].updateRate = rate;
+  _dataRefs[i].latestValue = value;
+  _dataRefs[i].forceUpdate = 0;
+  _dataRefs[i].nextUpdateTime = 0;
+  _dataRefs[i].updatedFlag = false;
+  _dataRefs[i].queued = false;
+  _dataRefs[i].dirty = false;
+  _dataRefs[i].explicitDirty = false;
+  if (rwmode == XPL_WRITE || rwmode == XPL_READWRITE)
+  {
+    _writeRefs[_writeRefsCount++] = i;
+  }
+  if (rwmode == XPL_READ || rwmode == XPL_READWRITE)
+  {
+    _readRefs[_readRefsCount++] = i;
+  }
   _dataRefsCount++;
   _allDataRefsRegistered = 0;
-  return (_dataRefsCount - 1);
+  return i;
 }
 
 int XPLDirect::registerCommand(XPString_t *commandName) // user will trigger commands with commandTrigger
 {
   if (_commandsCount >= XPLDIRECT_MAXCOMMANDS_ARDUINO)
   {
+    _registrationsDropped++;
     return -1;
   }
-  _commands[_commandsCount] = new _commandStructure;
-  _commands[_commandsCount]->commandName = commandName;
-  _commands[_commandsCount]->commandHandle = -1; // invalid until assigned by xplane
+  _commands[_commandsCount].commandName = commandName;
+  _commands[_commandsCount].nameHash = _nameHash(commandName);
+  _commands[_commandsCount].commandHandle = -1; // invalid until assigned by xplane
+  _commands[_commandsCount].registerPending = false;
   _commandsCount++;
   _allDataRefsRegistered = 0; // share this flag with the datarefs, true when everything is registered with xplane.
   return (_commandsCount - 1);